@@ -1,8 +1,6 @@
 #include "Animation.h"
 #include "CommonDefinitions.h"
 
-Spritesheet settings;
-
 static constexpr const char* AnimationNames[] =
 {
     "Idle",
@@ -18,14 +16,14 @@ static constexpr const char* DirectionNames[] =
 };
 
 Animation::Animation(const Spritesheet& spriteSheetDescr)
+: pSpritesheet(&spriteSheetDescr)
 {
-    settings = spriteSheetDescr;
-    sprite.setOrigin(settings.width / 2.0f, settings.height / 2.0f);
-    sprite.setScale((float)settings.scale, (float)settings.scale);
-    sprite.setTexture(TEXTURE(settings.texture));
+    sprite.setOrigin(spriteSheetDescr.width / 2.0f, spriteSheetDescr.height / 2.0f);
+    sprite.setScale((float)spriteSheetDescr.scale, (float)spriteSheetDescr.scale);
+    sprite.setTexture(TEXTURE(spriteSheetDescr.texture));
 }
 
-void Animation::update(b2Vec2 velocity)
+void Animation::update(b2Vec2 velocity, const sf::Time& deltaTime)
 {
     const float bias = 0.1f;
     const float velVectLen = velocity.Length();
@@ -46,19 +44,24 @@ void Animation::update(b2Vec2 velocity)
             else if (velocity.y >= bias) setDirection(Animation::Direction::DOWN);
         }
         const float scaleFactor = std::fminf(velVectLen, 1.0f);
-        elapsedTime += clock.restart() * scaleFactor;
+        elapsedTime += deltaTime * scaleFactor;
     }
     else
     {
         setType(Animation::Type::IDLE);
-        elapsedTime += clock.restart();
+        elapsedTime += deltaTime;
     }
 
     const char* directionName = DirectionNames[static_cast<int>(direction)];
     const char* animationName = AnimationNames[static_cast<int>(type)];
 
-    auto& animationInfo = settings.animations[animationName];
-    const int row_id = animationInfo.row_index[directionName];
+    // Const lookups only, animations update in parallel.
+    const Spritesheet& settings = *pSpritesheet;
+    auto animationIt = settings.animations.find(animationName);
+    if (animationIt == settings.animations.end() || animationIt->second.ms_per_frame <= 0) return;
+    const Spritesheet::Animation& animationInfo = animationIt->second;
+    auto rowIt = animationInfo.row_index.find(directionName);
+    const int row_id = (rowIt != animationInfo.row_index.end()) ? rowIt->second : 0;
     const int column_id = getColumnId(animationInfo.ms_per_frame, animationInfo.num_frames);
 
     sf::IntRect newTectureRect(settings.x_offset + (column_id * settings.width),
@@ -73,6 +76,14 @@ void Animation::draw(sf::RenderTarget& target, sf::RenderStates states) const
     target.draw(sprite, states);
 }
 
+void Animation::setState(const State& state)
+{
+    type = state.type;
+    direction = state.direction;
+    elapsedTime = sf::microseconds(state.elapsedMicroseconds);
+    sprite.setTextureRect(state.frame);
+}
+
 int Animation::getColumnId(int msPerFrame, int numOfFrames)
 {
     sf::Time fullAnimDuration = sf::milliseconds(msPerFrame * numOfFrames);
@@ -82,5 +93,5 @@ int Animation::getColumnId(int msPerFrame, int numOfFrames)
 
 std::string Animation::getName() 
 { 
-    return settings.name;
+    return pSpritesheet->name;
 }
\ No newline at end of file
@@ -25,7 +25,7 @@ public:
 
     Animation(const Spritesheet& spriteSheetDescr);
 
-    void update(b2Vec2 velocity);
+    void update(b2Vec2 velocity, const sf::Time& deltaTime);
 
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
 
@@ -39,16 +39,32 @@ public:
 
     std::string getName();
 
+    // Playback state, everything else comes from the spritesheet.
+    struct State
+    {
+        Type type = Type::IDLE;
+        Direction direction = Direction::RIGHT;
+        sf::Int64 elapsedMicroseconds = 0;
+        sf::IntRect frame;
+    };
+
+    State getState() const { return { type, direction, elapsedTime.asMicroseconds(), sprite.getTextureRect() }; }
+    void setState(const State& state);
+
+    const sf::Sprite& getSprite() const { return sprite; }
+
 private:
 
     int getColumnId(int msPerFrame, int numOfFrames);
 
+    // Owned by Config, read concurrently by animation jobs and never written during a level.
+    const Spritesheet* pSpritesheet = nullptr;
+
     sf::Sprite sprite;
     Type type = Type::IDLE;
     Direction direction = Direction::RIGHT;
 
     sf::Time elapsedTime;
-    sf::Clock clock;
 };
 
 struct Spritesheet
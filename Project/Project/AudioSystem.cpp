@@ -9,6 +9,10 @@ AudioSystem& AudioSystem::getInstance()
 
 void AudioSystem::playSound(const std::string& soundName)
 {
+    if (!isEnabled) return;
+
+    if (players.empty()) players.resize(NUM_PLAYERS);
+
     sf::Sound* pSound = nullptr;
     for (auto& player : players)
     {
@@ -50,6 +54,8 @@ void AudioSystem::stopSound(const std::string& soundName)
 
 void AudioSystem::playMusic(const std::string& musicName, float volume, bool loop)
 {
+    if (!isEnabled) return;
+
     if (!currentMusicName.empty())
     {
         sf::Music& music = MUSIC(currentMusicName);
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <array>
+#include <vector>
 #include <SFML/Audio.hpp>
 
 class AudioSystem
@@ -29,9 +30,15 @@ public:
     bool isMusicPlaying();
     std::string getCurrentMusic() { return currentMusicName; }
 
+    void setEnabled(bool enabled) { isEnabled = enabled; }
+    bool getEnabled() const { return isEnabled; }
+
 private:
     AudioSystem() = default;
 
-    std::array<Player, 10> players;
+    // Created on first use: every sf::Sound opens the audio device.
+    static constexpr std::size_t NUM_PLAYERS = 10;
+    std::vector<Player> players;
     std::string currentMusicName;
+    bool isEnabled = true;
 };
@@ -0,0 +1,48 @@
+#include "BodyTransforms.h"
+#include "CommonDefinitions.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BODY_TRANSFORMS_SSE
+#endif
+
+void BodyTransforms::resize(std::size_t count)
+{
+    for (std::vector<float>* pArray : { &previousX, &previousY, &previousAngle, &currentX, &currentY, &currentAngle, &x, &y, &rotation })
+    {
+        pArray->resize(count);
+    }
+}
+
+// result = (current * alpha + previous * (1 - alpha)) * scale, every path
+// rounds the same way so the lane width never shows on screen.
+static void blend(const float* previous, const float* current, float* result, float alpha, float scale, std::size_t begin, std::size_t end)
+{
+    const float beta = 1.0f - alpha;
+    std::size_t idx = begin;
+
+#ifdef BODY_TRANSFORMS_SSE
+    const __m128 alpha4 = _mm_set1_ps(alpha);
+    const __m128 beta4 = _mm_set1_ps(beta);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    for (; idx + 4 <= end; idx += 4)
+    {
+        const __m128 blended = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(current + idx), alpha4),
+                                          _mm_mul_ps(_mm_loadu_ps(previous + idx), beta4));
+        _mm_storeu_ps(result + idx, _mm_mul_ps(blended, scale4));
+    }
+#endif
+
+    for (; idx < end; ++idx)
+    {
+        const float blended = current[idx] * alpha + previous[idx] * beta;
+        result[idx] = blended * scale;
+    }
+}
+
+void BodyTransforms::convert(float alpha, std::size_t begin, std::size_t end)
+{
+    blend(previousX.data(), currentX.data(), x.data(), alpha, meterToPixel(1.0f), begin, end);
+    blend(previousY.data(), currentY.data(), y.data(), alpha, meterToPixel(1.0f), begin, end);
+    blend(previousAngle.data(), currentAngle.data(), rotation.data(), alpha, radianToDegree(1.0f), begin, end);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Entity.h"
+#include <SFML/System/Vector2.hpp>
+#include <vector>
+
+// Interpolated body transforms in structure of arrays form. A job gathers the
+// states of its range, converts the whole range in one pass and reads the
+// pixels and degrees back. Ranges of different jobs never overlap.
+class BodyTransforms
+{
+public:
+    // Keeps the capacity, entries are undefined until set.
+    void resize(std::size_t count);
+
+    // Meters and radians of the last two ticks.
+    void set(std::size_t idx, const BodyState& previous, const BodyState& current)
+    {
+        previousX[idx] = previous.position.x;
+        previousY[idx] = previous.position.y;
+        previousAngle[idx] = previous.angle;
+        currentX[idx] = current.position.x;
+        currentY[idx] = current.position.y;
+        currentAngle[idx] = current.angle;
+    }
+
+    // Blends [begin, end) by alpha into pixels and degrees, four entries at
+    // a time when the build targets SSE2.
+    void convert(float alpha, std::size_t begin, std::size_t end);
+
+    sf::Vector2f getPosition(std::size_t idx) const { return { x[idx], y[idx] }; }
+    float getRotation(std::size_t idx) const { return rotation[idx]; }
+
+    std::size_t size() const { return x.size(); }
+
+private:
+    std::vector<float> previousX;
+    std::vector<float> previousY;
+    std::vector<float> previousAngle;
+    std::vector<float> currentX;
+    std::vector<float> currentY;
+    std::vector<float> currentAngle;
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> rotation;
+};
\ No newline at end of file
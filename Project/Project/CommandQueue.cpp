@@ -0,0 +1,53 @@
+#include "CommandQueue.h"
+
+Command::Type Command::parseType(const std::string& action)
+{
+    if (action == "LEVEL") return Type::LOAD;
+    if (action == "EXIT") return Type::EXIT;
+    if (action == "MENU") return Type::MENU;
+    if (action == "BACK") return Type::BACK;
+    if (action == "QUICK_SAVE") return Type::QUICK_SAVE;
+    if (action == "QUICK_LOAD") return Type::QUICK_LOAD;
+    return Type::NONE;
+}
+
+CommandQueue::CommandQueue()
+{
+    Node* stub = new Node;
+    head = stub;
+    tail = stub;
+}
+
+CommandQueue::~CommandQueue()
+{
+    Command command;
+    while (pop(command)) {}
+    delete tail;
+}
+
+void CommandQueue::post(Command::Type type, std::vector<std::string> args)
+{
+    if (type == Command::Type::NONE) return;
+
+    Node* node = new Node;
+    node->command.type = type;
+    node->command.args = std::move(args);
+    node->command.postedAt = clock.getElapsedTime();
+
+    ++numPending;
+    Node* prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+bool CommandQueue::pop(Command& command)
+{
+    // The consumed node becomes the new stub, its command is moved out.
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) return false;
+
+    command = std::move(next->command);
+    delete tail;
+    tail = next;
+    --numPending;
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <SFML/System.hpp>
+#include <atomic>
+#include <string>
+#include <vector>
+
+struct Command
+{
+    enum class Type { NONE, LOAD, EXIT, MENU, BACK, QUICK_SAVE, QUICK_LOAD } type = Type::NONE;
+    std::vector<std::string> args;
+    sf::Time postedAt;
+
+    static Type parseType(const std::string& action);
+};
+
+// Multi-producer single-consumer queue. Any thread may post, only the main
+// loop drains. Producers never block each other: posting is one atomic exchange.
+class CommandQueue
+{
+public:
+    struct Stats
+    {
+        sf::Uint64 numExecuted = 0;
+        sf::Time lastWait;
+        sf::Time maxWait;
+        sf::Time totalWait;
+        int numPending = 0;
+
+        sf::Time averageWait() const { return numExecuted ? totalWait / static_cast<sf::Int64>(numExecuted) : sf::Time::Zero; }
+    };
+
+    CommandQueue();
+    ~CommandQueue();
+
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue& operator=(const CommandQueue&) = delete;
+
+    void post(Command::Type type, std::vector<std::string> args = {});
+
+    template <typename Handler>
+    int drain(int maxCommands, Handler&& handler);
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{ nullptr };
+        Command command;
+    };
+
+    bool pop(Command& command);
+
+    std::atomic<Node*> head;
+    Node* tail;
+    std::atomic<int> numPending{ 0 };
+
+    sf::Clock clock;
+    Stats stats;
+};
+
+template <typename Handler>
+int CommandQueue::drain(int maxCommands, Handler&& handler)
+{
+    int numDrained = 0;
+    Command command;
+    while (numDrained < maxCommands && pop(command))
+    {
+        const sf::Time wait = clock.getElapsedTime() - command.postedAt;
+        stats.lastWait = wait;
+        stats.totalWait += wait;
+        if (wait > stats.maxWait) stats.maxWait = wait;
+        ++stats.numExecuted;
+
+        handler(command);
+        ++numDrained;
+    }
+    stats.numPending = numPending;
+    return numDrained;
+}
\ No newline at end of file
@@ -8,13 +8,15 @@
 #include "Scene.h"
 #include "Entity.h"
 #include "Game.h"
+#include "InputSystem.h"
+#include "JobSystem.h"
 
 // Conversions
 constexpr float SCALE_FACTOR = 100.0f;
-static constexpr float pixelToMeter(int pixels) { return pixels / SCALE_FACTOR; }
-static constexpr int meterToPixel(float meters) { return static_cast<int>(meters * SCALE_FACTOR); }
-static constexpr float degreeToRadian(float degrees) { return degrees / 180 * M_PI; }
-static constexpr float radianToDegree(float radians) { return radians * 180 * M_PI; }
+static constexpr float pixelToMeter(float pixels) { return pixels / SCALE_FACTOR; }
+static constexpr float meterToPixel(float meters) { return meters * SCALE_FACTOR; }
+static constexpr float degreeToRadian(float degrees) { return degrees * static_cast<float>(M_PI / 180.0); }
+static constexpr float radianToDegree(float radians) { return radians * static_cast<float>(180.0 / M_PI); }
 
 // Resource
 #define TEXTURE(name) (g_resources[(name)].get<Resource::Type::TEXTURE>())
@@ -38,13 +40,22 @@ static constexpr float radianToDegree(float radians) { return radians * 180 * M_
 #define LOG_INFO(logText)
 #endif
 
+#define LOG_WARNING(logText) (UiManager::getInstance().log((logText), UiManager::LogType::WARNING))
+
 #define LOG_ERROR(logText) (UiManager::getInstance().log((logText), UiManager::LogType::ERROR))
 
 #define SHOW_TEXT(TEXT) (UiManager::getInstance().AddStaticText((TEXT)))
 
 #define UPDATE_UI(TIME) (UiManager::getInstance().update((TIME)))
 
-#define COUNT_RENDER(TIME) (UiManager::getInstance().calculateFps((TIME)))
+#define COUNT_RENDER(TIME, JITTER) (UiManager::getInstance().calculateFps((TIME), (JITTER)))
+
+// InputSystem
+#define INPUT_INSTANCE InputSystem::getInstance()
+#define IS_KEY_PRESSED(KEY) (InputSystem::getInstance().isKeyPressed((KEY)))
+
+// JobSystem
+#define JOBS JobSystem::getInstance()
 
 // Config
 #define MAIN_CONFIG_FILE "content\\config\\settings.xml"
@@ -56,5 +67,7 @@ static constexpr float radianToDegree(float radians) { return radians * 180 * M_
 #define GAME_INIT() (Game::getInstance())
 #define GAME_INSTANCE (Game::getInstance())
 #define GAME_START() (Game::getInstance().blockingRun())
+#define GAME_START_HEADLESS() (Game::getInstance().headlessRun())
+#define GAME_START_BENCHMARK() (Game::getInstance().benchmarkRun())
 
 
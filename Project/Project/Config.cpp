@@ -20,7 +20,7 @@ const char* KeyNames[] =
 
 Action BuildSoundAction(const std::string& soundName)
 {
-    return [soundName](Entity& entity, bool pressed)
+    return [soundName](Scene&, EntityHandle entity, bool pressed)
     {
         if (pressed)
         {
@@ -35,10 +35,11 @@ Action BuildSoundAction(const std::string& soundName)
 
 Action BuildMoveAction(const b2Vec2& vector)
 {
-    return [vector](Entity& entity, bool pressed)
+    return [vector](Scene& scene, EntityHandle entity, bool pressed)
     {
-        Component* pComponent = entity.getComponent(Component::Type::BODY);
-        b2Body& body = *std::get<b2Body*>(pComponent->var);
+        Body* pBody = scene.entities.getComponent<Component::Type::BODY>(entity);
+        if (pBody == nullptr) return;
+        b2Body& body = *pBody->pBody;
 
         const float maxVel = 10.0f;
         const float forceScale = 20;
@@ -47,6 +48,7 @@ Action BuildMoveAction(const b2Vec2& vector)
         {
             const b2Vec2 scaledForce = { vector.x * forceScale, vector.y * forceScale };
             body.ApplyForceToCenter(scaledForce, true);
+            scene.wakeBody(entity);
         }
         else
         {
@@ -55,6 +57,23 @@ Action BuildMoveAction(const b2Vec2& vector)
     };
 }
 
+Action BuildSpawnAction(PrefabId prefabId, const sf::Vector2f& offset)
+{
+    bool wasPressed = false;
+    return [prefabId, offset, wasPressed](Scene& scene, EntityHandle entity, bool pressed) mutable
+    {
+        // One instance per key press, not per tick.
+        const bool isPressedNow = pressed && !wasPressed;
+        wasPressed = pressed;
+        if (!isPressedNow) return;
+
+        SpawnDesc spawn;
+        scene.getEntityPosition(entity, spawn.position);
+        spawn.position += offset;
+        scene.commands.instantiate(prefabId, spawn);
+    };
+}
+
 static constexpr const char* PATH_DELIMITER = "\\";
 
 static constexpr const char* XML_TAG_SPRITE_SHEET = "Spritesheet";
@@ -88,9 +107,16 @@ Config::Config(const std::string& filepath)
     doc.LoadFile();
     pElem = hDoc.FirstChildElement().Element();
     hRoot = TiXmlHandle(pElem);
+    headlessMode = getHeadlessSettings().enabled;
     LoadResoures(hRoot);
 }
 
+void Config::setCommandLine(int argc, char* argv[])
+{
+    commandLine.assign(argv + 1, argv + argc);
+    headlessMode = getHeadlessSettings().enabled;
+}
+
 void Config::LoadResoures(TiXmlHandle rootHandle)
 {
     static constexpr const char* XML_TAG_RESOURCES = "Resources";
@@ -105,6 +131,15 @@ void Config::LoadResoures(TiXmlHandle rootHandle)
     static constexpr const char* XML_TAG_RESOURCE_NAME = "name";
     static constexpr const char* XML_TAG_RESOURCE_EXT = "ext";
 
+    struct PendingLoad
+    {
+        Resource* pResource;
+        Resource::Type type;
+        std::string name;
+        std::string path;
+    };
+    std::vector<PendingLoad> pendingLoads;
+
     TiXmlElement* resouresElem = rootHandle.FirstChild(XML_TAG_RESOURCES).Element();
     for (resouresElem; resouresElem != nullptr; resouresElem = resouresElem->NextSiblingElement())
     {
@@ -122,6 +157,9 @@ void Config::LoadResoures(TiXmlHandle rootHandle)
         else if (typeString == XML_TAG_RESOURCE_TYPE_IMAGE)   type = Resource::Type::IMAGE;
         else continue;
 
+        // No GL context or audio device without a window.
+        if (headlessMode && type != Resource::Type::IMAGE && type != Resource::Type::FONT) continue;
+
         TiXmlElement* resourceElem = resouresElem->FirstChild(XML_TAG_RESOURCE)->ToElement();
         for (resourceElem; resourceElem != nullptr; resourceElem = resourceElem->NextSiblingElement())
         {
@@ -129,16 +167,30 @@ void Config::LoadResoures(TiXmlHandle rootHandle)
             const std::string resourceExt = resourceElem->Attribute(XML_TAG_RESOURCE_EXT);
             const std::string resourcePath = directory + PATH_DELIMITER + resourceName + "." + resourceExt;
 
-            LOAD_RESOURCE(type, resourceName, resourcePath);
-
             if (type == Resource::Type::TEXTURE)
             {
+                LOAD_RESOURCE(type, resourceName, resourcePath);
+
                 bool tile = true;
                 resourceElem->QueryBoolAttribute("tile", &tile);
                 if (tile) TEXTURE(resourceName).setRepeated(true);
             }
+            else if (g_resources.count(resourceName) == 0)
+            {
+                pendingLoads.push_back({ &g_resources[resourceName], type, resourceName, resourcePath });
+            }
         }
     }
+
+    // Textures need this thread's GL context, everything else is decoded on the workers.
+    JOBS.parallelFor(pendingLoads.size(), 1, [&pendingLoads](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t idx = begin; idx < end; ++idx)
+        {
+            const PendingLoad& load = pendingLoads[idx];
+            load.pResource->load(load.type, load.name, load.path);
+        }
+    });
 }
 
 Config::Window Config::getWindowSettings()
@@ -153,6 +205,173 @@ Config::Window Config::getWindowSettings()
     return windowSettings;
 }
 
+Config::Simulation Config::getSimulationSettings()
+{
+    Simulation simulationSettings;
+    TiXmlElement* pSimulationNode = hRoot.FirstChild("GameLoop").FirstChild("Simulation").Element();
+    if (pSimulationNode != nullptr)
+    {
+        pSimulationNode->QueryIntAttribute("tickRate", &simulationSettings.tickRate);
+        pSimulationNode->QueryIntAttribute("maxTicksPerFrame", &simulationSettings.maxTicksPerFrame);
+    }
+    if (simulationSettings.tickRate <= 0) simulationSettings.tickRate = Simulation().tickRate;
+    if (simulationSettings.maxTicksPerFrame <= 0) simulationSettings.maxTicksPerFrame = 1;
+    return simulationSettings;
+}
+
+Config::Rendering Config::getRenderingSettings()
+{
+    Rendering renderingSettings;
+    TiXmlElement* pRenderingNode = hRoot.FirstChild("GameLoop").FirstChild("Rendering").Element();
+    if (pRenderingNode != nullptr)
+    {
+        pRenderingNode->QueryBoolAttribute("threaded", &renderingSettings.threaded);
+    }
+    return renderingSettings;
+}
+
+Config::FrameRate Config::getFrameRateSettings()
+{
+    FrameRate frameRateSettings;
+    TiXmlElement* pFrameRateNode = hRoot.FirstChild("GameLoop").FirstChild("FrameRate").Element();
+    if (pFrameRateNode != nullptr)
+    {
+        pFrameRateNode->QueryIntAttribute("gameplay", &frameRateSettings.gameplay);
+        pFrameRateNode->QueryIntAttribute("menu", &frameRateSettings.menu);
+        pFrameRateNode->QueryIntAttribute("unfocused", &frameRateSettings.unfocused);
+        pFrameRateNode->QueryIntAttribute("spinMicroseconds", &frameRateSettings.spinMicroseconds);
+    }
+    return frameRateSettings;
+}
+
+Config::Commands Config::getCommandsSettings()
+{
+    Commands commandsSettings;
+    TiXmlElement* pCommandsNode = hRoot.FirstChild("GameLoop").FirstChild("Commands").Element();
+    if (pCommandsNode != nullptr)
+    {
+        pCommandsNode->QueryIntAttribute("maxPerFrame", &commandsSettings.maxPerFrame);
+    }
+    if (commandsSettings.maxPerFrame <= 0) commandsSettings.maxPerFrame = 1;
+    return commandsSettings;
+}
+
+Config::Jobs Config::getJobsSettings()
+{
+    Jobs jobsSettings;
+    TiXmlElement* pJobsNode = hRoot.FirstChild("GameLoop").FirstChild("Jobs").Element();
+    if (pJobsNode != nullptr)
+    {
+        pJobsNode->QueryIntAttribute("workers", &jobsSettings.workers);
+    }
+    return jobsSettings;
+}
+
+Config::Governor Config::getGovernorSettings()
+{
+    Governor governorSettings;
+    TiXmlElement* pGovernorNode = hRoot.FirstChild("GameLoop").FirstChild("Governor").Element();
+    if (pGovernorNode != nullptr)
+    {
+        pGovernorNode->QueryIntAttribute("budgetMicroseconds", &governorSettings.budgetMicroseconds);
+    }
+    return governorSettings;
+}
+
+Config::Input Config::getInputSettings()
+{
+    Input inputSettings;
+    TiXmlElement* pInputNode = hRoot.FirstChild("GameLoop").FirstChild("Input").Element();
+    if (pInputNode != nullptr)
+    {
+        const char* pRecordPath = pInputNode->Attribute("record");
+        if (pRecordPath != nullptr) inputSettings.record = pRecordPath;
+        const char* pReplayPath = pInputNode->Attribute("replay");
+        if (pReplayPath != nullptr) inputSettings.replay = pReplayPath;
+    }
+
+    for (std::size_t idx = 0; idx + 1 < commandLine.size(); ++idx)
+    {
+        const std::string& arg = commandLine[idx];
+        if (arg == "--record") inputSettings.record = commandLine[++idx];
+        else if (arg == "--replay") inputSettings.replay = commandLine[++idx];
+    }
+    return inputSettings;
+}
+
+Config::Headless Config::getHeadlessSettings()
+{
+    Headless headlessSettings;
+    TiXmlElement* pHeadlessNode = hRoot.FirstChild("GameLoop").FirstChild("Headless").Element();
+    if (pHeadlessNode != nullptr)
+    {
+        pHeadlessNode->QueryBoolAttribute("enabled", &headlessSettings.enabled);
+        pHeadlessNode->QueryIntAttribute("ticks", &headlessSettings.ticks);
+        const char* pLevelName = pHeadlessNode->Attribute("level");
+        if (pLevelName != nullptr) headlessSettings.level = pLevelName;
+        pHeadlessNode->QueryBoolAttribute("timeRestore", &headlessSettings.timeRestore);
+    }
+
+    for (std::size_t idx = 0; idx < commandLine.size(); ++idx)
+    {
+        const std::string& arg = commandLine[idx];
+        const bool hasValue = idx + 1 < commandLine.size();
+        if (arg == "--headless") headlessSettings.enabled = true;
+        else if (arg == "--ticks" && hasValue) headlessSettings.ticks = std::atoi(commandLine[++idx].c_str());
+        else if (arg == "--level" && hasValue) headlessSettings.level = commandLine[++idx];
+        else if (arg == "--time-restore") headlessSettings.timeRestore = true;
+    }
+
+    // Replays and benchmarks always run as fast as possible without a window.
+    if (!getInputSettings().replay.empty()) headlessSettings.enabled = true;
+    if (getBenchmarkSettings().enabled) headlessSettings.enabled = true;
+
+    if (headlessSettings.level.empty()) headlessSettings.level = getStartLevelName();
+    return headlessSettings;
+}
+
+static std::vector<int> parseScales(const std::string& text)
+{
+    // "1 10 100" or "1,10,100".
+    std::vector<int> scales;
+    std::size_t begin = 0;
+    while (begin < text.size())
+    {
+        std::size_t end = text.find_first_of(" ,", begin);
+        if (end == std::string::npos) end = text.size();
+        const int scale = std::atoi(text.substr(begin, end - begin).c_str());
+        if (scale > 0) scales.push_back(scale);
+        begin = end + 1;
+    }
+    return scales;
+}
+
+Config::Benchmark Config::getBenchmarkSettings()
+{
+    Benchmark benchmarkSettings;
+    TiXmlElement* pBenchmarkNode = hRoot.FirstChild("GameLoop").FirstChild("Benchmark").Element();
+    if (pBenchmarkNode != nullptr)
+    {
+        pBenchmarkNode->QueryBoolAttribute("enabled", &benchmarkSettings.enabled);
+        pBenchmarkNode->QueryIntAttribute("ticks", &benchmarkSettings.ticks);
+        const char* pLevelName = pBenchmarkNode->Attribute("level");
+        if (pLevelName != nullptr) benchmarkSettings.level = pLevelName;
+        const char* pScales = pBenchmarkNode->Attribute("scales");
+        if (pScales != nullptr) benchmarkSettings.scales = parseScales(pScales);
+    }
+
+    for (std::size_t idx = 0; idx < commandLine.size(); ++idx)
+    {
+        const std::string& arg = commandLine[idx];
+        const bool hasValue = idx + 1 < commandLine.size();
+        if (arg == "--benchmark") benchmarkSettings.enabled = true;
+        else if (arg == "--ticks" && hasValue) benchmarkSettings.ticks = std::atoi(commandLine[++idx].c_str());
+        else if (arg == "--level" && hasValue) benchmarkSettings.level = commandLine[++idx];
+        else if (arg == "--scales" && hasValue) benchmarkSettings.scales = parseScales(commandLine[++idx]);
+    }
+    return benchmarkSettings;
+}
+
 void Config::loadAnimationSettings(TiXmlHandle rootHandle)
 {
     TiXmlElement* spriteSheetElem = rootHandle.FirstChild(XML_TAG_SPRITE_SHEET).Element();
@@ -190,7 +409,7 @@ void Config::loadAnimationSettings(TiXmlHandle rootHandle)
     }
 }
 
-ControlActions Config::loadActions(Scene& scene, Entity& entity, const std::string& controllerName)
+ControlActions Config::loadActions(Scene& scene, EntityDesc& entity, const std::string& controllerName)
 {
     std::map<std::string, ActionList> actions;
     ControlActions controller;
@@ -208,6 +427,7 @@ ControlActions Config::loadActions(Scene& scene, Entity& entity, const std::stri
     static constexpr const char* ACTIONS = "Actions";
     static constexpr const char* SOUND = "Sound";
     static constexpr const char* MOVE = "Move";
+    static constexpr const char* SPAWN = "Spawn";
 
     static constexpr const char* CONTROLS = "Controls";
     static constexpr const char* ACTION = "action";
@@ -240,6 +460,21 @@ ControlActions Config::loadActions(Scene& scene, Entity& entity, const std::stri
                     actionElem->QueryFloatAttribute("y", &vector.y);
                     actions[actionBundleElemName].push_back(BuildMoveAction(vector));
                 }
+                else if (actionName == SPAWN)
+                {
+                    const char* pPrefabName = actionElem->Attribute("prefab");
+                    const PrefabId prefabId = (pPrefabName != nullptr) ? scene.getPrefab(pPrefabName) : INVALID_PREFAB;
+                    if (prefabId == INVALID_PREFAB)
+                    {
+                        LOG_ERROR(std::string("unknown prefab in ") + controllerName);
+                        continue;
+                    }
+
+                    sf::Vector2f offset;
+                    actionElem->QueryFloatAttribute("x", &offset.x);
+                    actionElem->QueryFloatAttribute("y", &offset.y);
+                    actions[actionBundleElemName].push_back(BuildSpawnAction(prefabId, offset));
+                }
 
             }
         }
@@ -281,7 +516,7 @@ ControlActions Config::loadActions(Scene& scene, Entity& entity, const std::stri
     return controller;
 }
 
-void Config::loadComponent(TiXmlElement* componentElem, Scene& scene, Entity& entity)
+void Config::loadComponent(TiXmlElement* componentElem, Scene& scene, EntityDesc& entity, const sf::Vector2f& offset)
 {
     static constexpr const char* XML_TAG_ENTITY_COMPONENT_BODY = "Body";
     static constexpr const char* XML_TAG_ENTITY_COMPONENT_SHAPE = "Shape";
@@ -307,15 +542,17 @@ void Config::loadComponent(TiXmlElement* componentElem, Scene& scene, Entity& en
     std::string textureName = (pTexture != nullptr) ? pTexture : "";
 
     Component component;
-    component.setPosition(x, y);
 
     const std::string componentName = componentElem->Value();
     if (componentName == XML_TAG_ENTITY_COMPONENT_BODY)
     {
-        component.type = Component::Type::BODY;
         const std::string componentTypeString = componentElem->Attribute(XML_TAG_ENTITY_COMPONENT_TYPE);
         const b2BodyType bodyType = (componentTypeString == XML_TAG_ENTITY_COMPONENT_TYPE_DYNAMIC) ? b2_dynamicBody : b2_staticBody;
 
+        // Bodies live in world space, repeated copies are moved here.
+        x += offset.x;
+        y += offset.y;
+
         b2BodyDef bodyDef;
         bodyDef.type = bodyType;
         bodyDef.position.Set(pixelToMeter(x), pixelToMeter(y));
@@ -332,11 +569,16 @@ void Config::loadComponent(TiXmlElement* componentElem, Scene& scene, Entity& en
         fixture.friction = 0.8f;
         body->CreateFixture(&fixture);
         body->SetFixedRotation(true);
-        component.var = body;
+
+        Body bodyComponent;
+        bodyComponent.pBody = body;
+        bodyComponent.currentState = { body->GetPosition(), body->GetAngle() };
+        bodyComponent.previousState = bodyComponent.currentState;
+        component.var = bodyComponent;
+        entity.position = { x, y };
     }
     else if (componentName == XML_TAG_ENTITY_COMPONENT_SHAPE)
     {
-        component.type = Component::Type::SHAPE;
         component.var = sf::RectangleShape({ width, height });
         sf::RectangleShape& rect = std::get<sf::RectangleShape>(component.var);
         rect.setOrigin(width / 2, height / 2);
@@ -348,7 +590,6 @@ void Config::loadComponent(TiXmlElement* componentElem, Scene& scene, Entity& en
     }
     else if (componentName == XML_TAG_ENTITY_COMPONENT_SPRITE)
     {
-        component.type = Component::Type::SPRITE;
         const sf::IntRect intRect({0, 0}, { (int)width, (int)height });
         component.var = sf::Sprite(TEXTURE(textureName));
         sf::Sprite& sprite = std::get<sf::Sprite>(component.var);
@@ -358,53 +599,161 @@ void Config::loadComponent(TiXmlElement* componentElem, Scene& scene, Entity& en
     }
     else if (componentName == XML_TAG_ENTITY_COMPONENT_ANIMAION)
     {
-        component.type = Component::Type::ANIMATION;
         const char* pAnimationName = componentElem->Attribute("name");
-        if (pAnimationName != nullptr)
-        {
-            component.var = Animation(spriteSheetDescriptions[pAnimationName]);
-        }
+        if (pAnimationName == nullptr) return;
+        component.var = Animation(spriteSheetDescriptions[pAnimationName]);
     }
     else if (componentName == XML_TAG_ENTITY_COMPONENT_CAMERA)
     {
-        component.type = Component::Type::CAMERA;
         component.var = sf::View({ x, y }, { width, height });
     }
     else if (componentName == "Controller")
     {
-        component.type = Component::Type::CONTROLLER;
         const char* pControllerName = componentElem->Attribute("name");
-        if (pControllerName != nullptr)
-        {
-            component.var = loadActions(scene, entity, pControllerName);
-        }
+        if (pControllerName == nullptr) return;
+        component.var = loadActions(scene, entity, pControllerName);
+    }
+    else
+    {
+        LOG_ERROR(std::string("unknown component: ") + componentName);
+        return;
     }
 
-    entity.components.push_back(component);
+    entity.components.push_back(std::move(component));
 }
 
-void Config::loadEntity(TiXmlElement* entityElem, Scene& scene)
+void Config::loadEntity(TiXmlElement* entityElem, Scene& scene, EntityHandle parent, const sf::Vector2f& offset, const std::string& nameSuffix)
 {
     static constexpr const char* XML_TAG_ENTITY_NAME = "name";
+    static constexpr const char* XML_TAG_ENTITY = "Entity";
 
-    Entity entity;
-    entity.name = entityElem->Attribute(XML_TAG_ENTITY_NAME);
+    EntityDesc entity;
+    const char* pEntityName = entityElem->Attribute(XML_TAG_ENTITY_NAME);
+    if (pEntityName != nullptr) entity.name = pEntityName + nameSuffix;
+    entity.parent = parent;
+    entityElem->QueryFloatAttribute("x", &entity.position.x);
+    entityElem->QueryFloatAttribute("y", &entity.position.y);
+    entityElem->QueryFloatAttribute("rotation", &entity.rotation);
+    if (parent == INVALID_ENTITY) entity.position += offset;
 
     LOG_INFO(std::string("entity: ") + entity.name);
 
-    TiXmlElement* componentElem = entityElem->FirstChild()->ToElement();
+    TiXmlElement* componentElem = entityElem->FirstChildElement();
     for (componentElem; componentElem != nullptr; componentElem = componentElem->NextSiblingElement())
     {
-        loadComponent(componentElem, scene, entity);
+        if (std::string(componentElem->Value()) == XML_TAG_ENTITY) continue;
+        loadComponent(componentElem, scene, entity, offset);
     }
 
-    scene.sceneGraph.push_back(entity);
+    const EntityHandle handle = scene.createEntity(std::move(entity));
+    scene.streamEntity(handle, parent);
+
+    // Nested entities are placed relative to this one.
+    TiXmlElement* childElem = entityElem->FirstChildElement(XML_TAG_ENTITY);
+    for (childElem; childElem != nullptr; childElem = childElem->NextSiblingElement(XML_TAG_ENTITY))
+    {
+        loadEntity(childElem, scene, handle, offset, nameSuffix);
+    }
+}
+
+void Config::loadRepeat(TiXmlElement* repeatElem, Scene& scene)
+{
+    static constexpr const char* XML_TAG_ENTITY = "Entity";
+
+    int columns = 1, rows = 1;
+    sf::Vector2f origin, step;
+    repeatElem->QueryIntAttribute("columns", &columns);
+    repeatElem->QueryIntAttribute("rows", &rows);
+    repeatElem->QueryFloatAttribute("x", &origin.x);
+    repeatElem->QueryFloatAttribute("y", &origin.y);
+    repeatElem->QueryFloatAttribute("stepX", &step.x);
+    repeatElem->QueryFloatAttribute("stepY", &step.y);
+    rows *= repeatScale;
+
+    // Copies are numbered row by row, names get "_<number>" so they stay unique.
+    int number = 0;
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int column = 0; column < columns; ++column, ++number)
+        {
+            const sf::Vector2f offset = { origin.x + column * step.x, origin.y + row * step.y };
+            const std::string nameSuffix = "_" + std::to_string(number);
+            TiXmlElement* entityElem = repeatElem->FirstChildElement(XML_TAG_ENTITY);
+            for (entityElem; entityElem != nullptr; entityElem = entityElem->NextSiblingElement(XML_TAG_ENTITY))
+            {
+                loadEntity(entityElem, scene, INVALID_ENTITY, offset, nameSuffix);
+            }
+        }
+    }
+}
+
+void Config::loadStreaming(TiXmlHandle rootHandle, Scene& scene)
+{
+    LevelStreaming::Settings settings;
+    TiXmlElement* streamingElem = rootHandle.FirstChild("Streaming").Element();
+    if (streamingElem != nullptr)
+    {
+        streamingElem->QueryFloatAttribute("regionSize", &settings.regionSize);
+        streamingElem->QueryIntAttribute("activeRadius", &settings.activeRadius);
+        streamingElem->QueryIntAttribute("keepRadius", &settings.keepRadius);
+        streamingElem->QueryIntAttribute("maxTransitionsPerTick", &settings.maxTransitionsPerTick);
+    }
+    scene.streaming.configure(settings);
+}
+
+void Config::loadContacts(TiXmlHandle rootHandle, Scene& scene)
+{
+    TiXmlElement* contactsElem = rootHandle.FirstChild("Contacts").Element();
+    if (contactsElem == nullptr) return;
+
+    int capacity = 0;
+    float minImpulse = 1.0f;
+    contactsElem->QueryIntAttribute("capacity", &capacity);
+    contactsElem->QueryFloatAttribute("minImpulse", &minImpulse);
+    scene.contacts.reserve(std::max(capacity, 0));
+    scene.contacts.setImpactThreshold(minImpulse);
+
+    // One sound per tick however many bodies hit at once.
+    const char* pImpactSound = contactsElem->Attribute("impactSound");
+    if (pImpactSound != nullptr)
+    {
+        const std::string impactSound = pImpactSound;
+        scene.addContactHandler([impactSound](Scene&, const ContactEvents& contacts)
+        {
+            if (!contacts.getEvents(ContactEvents::Type::IMPACT).empty()) PLAY_SOUND(impactSound);
+        });
+    }
+}
+
+void Config::loadPrefabs(TiXmlHandle rootHandle, Scene& scene)
+{
+    static constexpr const char* XML_TAG_PREFAB = "Prefab";
+
+    TiXmlElement* prefabElem = rootHandle.FirstChild("Prefabs").FirstChild(XML_TAG_PREFAB).Element();
+    for (prefabElem; prefabElem != nullptr; prefabElem = prefabElem->NextSiblingElement(XML_TAG_PREFAB))
+    {
+        const char* pPrefabName = prefabElem->Attribute("name");
+        if (pPrefabName == nullptr) continue;
+
+        int poolSize = 0;
+        prefabElem->QueryIntAttribute("pool", &poolSize);
+
+        LOG_INFO(std::string("prefab: ") + pPrefabName);
+
+        EntityDesc prefab;
+        TiXmlElement* componentElem = prefabElem->FirstChildElement();
+        for (componentElem; componentElem != nullptr; componentElem = componentElem->NextSiblingElement())
+        {
+            loadComponent(componentElem, scene, prefab);
+        }
+        scene.addPrefab(pPrefabName, std::move(prefab), std::max(poolSize, 0));
+    }
 }
 
 void Config::loadEntities(TiXmlHandle rootHandle, Scene& scene)
 {
     auto sceneHandle = rootHandle.FirstChild("Scene");
-    TiXmlElement* entityElem = sceneHandle.FirstChild("Entity").Element();
+    TiXmlElement* entityElem = sceneHandle.FirstChildElement().Element();
     for (entityElem; entityElem != nullptr; entityElem = entityElem->NextSiblingElement())
     {
         const std::string elemName = entityElem->Value();
@@ -412,6 +761,10 @@ void Config::loadEntities(TiXmlHandle rootHandle, Scene& scene)
         {
             loadEntity(entityElem, scene);
         }
+        else if (elemName == "Repeat")
+        {
+            loadRepeat(entityElem, scene);
+        }
     }
 }
 
@@ -439,6 +792,7 @@ void Config::loadMenu(TiXmlHandle menuHandle, Scene& scene)
             option.type = Menu::Option::Type::TEXT_OPTION;
             option.name = optionElem->Attribute("name");
             option.action = optionElem->Attribute("action");
+            option.command = Command::parseType(option.action);
 
             const char* args_str = optionElem->Attribute("args");
             if (args_str != nullptr)
@@ -527,6 +881,9 @@ void Config::loadLevel(const std::string& levelName, Scene& scene)
     LoadResoures(hLevelRoot);
     loadAnimationSettings(hLevelRoot);
     loadPlaylist(hLevelRoot);
+    loadStreaming(hLevelRoot, scene);
+    loadContacts(hLevelRoot, scene);
+    loadPrefabs(hLevelRoot, scene);
     loadEntities(hLevelRoot, scene);
     loadUI(hLevelRoot, scene);
 
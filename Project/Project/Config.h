@@ -9,6 +9,7 @@
 #include <unordered_map>
 #include <map>
 #include <set>
+#include <algorithm>
 #include <SFML/Window.hpp>
 
 struct Scene;
@@ -24,6 +25,64 @@ public:
         std::string icon;
     };
 
+    struct Simulation
+    {
+        int tickRate = 60;
+        int maxTicksPerFrame = 5;
+    };
+
+    struct Rendering
+    {
+        bool threaded = false;
+    };
+
+    struct FrameRate
+    {
+        int gameplay = 144;
+        int menu = 30;
+        int unfocused = 10;
+        int spinMicroseconds = 2000;
+    };
+
+    struct Governor
+    {
+        int budgetMicroseconds = 0;
+    };
+
+    struct Jobs
+    {
+        int workers = -1;
+    };
+
+    struct Input
+    {
+        std::string record;
+        std::string replay;
+    };
+
+    struct Commands
+    {
+        int maxPerFrame = 16;
+    };
+
+    struct Headless
+    {
+        bool enabled = false;
+        int ticks = 10000;
+        std::string level;
+        // Restores the level start after the report and prints how long it took.
+        bool timeRestore = false;
+    };
+
+    // Runs headless, the level is loaded once per repeat scale.
+    struct Benchmark
+    {
+        bool enabled = false;
+        int ticks = 300;
+        std::string level = "stress_level";
+        std::vector<int> scales = { 1, 10, 100 };
+    };
+
     Config(const Config&) = delete;
     Config& operator=(const Config&) = delete;
 
@@ -33,24 +92,56 @@ public:
 
     Window getWindowSettings();
 
+    Simulation getSimulationSettings();
+
+    Rendering getRenderingSettings();
+
+    FrameRate getFrameRateSettings();
+
+    Commands getCommandsSettings();
+
+    Input getInputSettings();
+
+    Jobs getJobsSettings();
+
+    Governor getGovernorSettings();
+
+    Headless getHeadlessSettings();
+
+    Benchmark getBenchmarkSettings();
+
+    void setCommandLine(int argc, char* argv[]);
+
+    bool isHeadless() const { return headlessMode; }
+
     void loadAnimationSettings(TiXmlHandle rootHandle);
 
-    ControlActions loadActions(Scene& scene, Entity& entity, const std::string& controllerName);
+    ControlActions loadActions(Scene& scene, EntityDesc& entity, const std::string& controllerName);
 
     std::vector<std::string> readLevelList();
     std::string getStartLevelName();
 
     void loadLevel(const std::string& levelName, Scene& scene);
 
+    // Multiplies the rows of every Repeat element, for stress levels.
+    void setRepeatScale(int scale) { repeatScale = std::max(scale, 1); }
+
     std::vector<std::string> musicPlaylist;
 
     std::string currentLevel;
 
 private:
     Config(const std::string& filepath);
+    void loadStreaming(TiXmlHandle rootHandle, Scene& scene);
+    void loadContacts(TiXmlHandle rootHandle, Scene& scene);
+    void loadPrefabs(TiXmlHandle rootHandle, Scene& scene);
     void loadEntities(TiXmlHandle rootHandle, Scene& scene);
-    void loadEntity(TiXmlElement* entityElem, Scene& scene);
-    void loadComponent(TiXmlElement* componentElem, Scene& scene, Entity& entity);
+    void loadRepeat(TiXmlElement* repeatElem, Scene& scene);
+
+    // offset moves top level entities and every body, nameSuffix goes after each name.
+    void loadEntity(TiXmlElement* entityElem, Scene& scene, EntityHandle parent = INVALID_ENTITY,
+                    const sf::Vector2f& offset = { 0.0f, 0.0f }, const std::string& nameSuffix = "");
+    void loadComponent(TiXmlElement* componentElem, Scene& scene, EntityDesc& entity, const sf::Vector2f& offset = { 0.0f, 0.0f });
 
     void loadMenu(TiXmlHandle menuHandle, Scene& scene);
     void loadUI(TiXmlHandle rootHandle, Scene& scene);
@@ -65,4 +156,8 @@ private:
     std::string levelDir;
     std::string startLevel;
 
+    std::vector<std::string> commandLine;
+    bool headlessMode = false;
+    int repeatScale = 1;
+
 };
@@ -0,0 +1,122 @@
+#include "ContactEvents.h"
+#include "CommonDefinitions.h"
+#include <algorithm>
+#include <tuple>
+
+void ContactEvents::reserve(std::size_t capacity)
+{
+    for (std::vector<Event>& typeEvents : events)
+    {
+        typeEvents.reserve(capacity);
+    }
+    touched.reserve(capacity);
+}
+
+// Body user data holds the slot index, see Scene::createEntity.
+static EntityHandle getEntity(const EntityStorage& entities, const b2Fixture* pFixture)
+{
+    const std::uintptr_t index = reinterpret_cast<std::uintptr_t>(pFixture->GetBody()->GetUserData());
+    return entities.getHandle(static_cast<std::uint32_t>(index));
+}
+
+void ContactEvents::record(Type type, b2Contact* contact, const sf::Vector2f& point, float impulse)
+{
+    const EntityHandle entityA = getEntity(entities, contact->GetFixtureA());
+    const EntityHandle entityB = getEntity(entities, contact->GetFixtureB());
+    const bool isSensor = contact->GetFixtureA()->IsSensor() || contact->GetFixtureB()->IsSensor();
+
+    std::vector<Event>& typeEvents = events[static_cast<std::size_t>(type)];
+    typeEvents.push_back({ entityA, entityB, point, impulse, isSensor });
+    typeEvents.push_back({ entityB, entityA, point, impulse, isSensor });
+}
+
+void ContactEvents::touch(b2Contact* contact)
+{
+    touched.push_back(getEntity(entities, contact->GetFixtureA()));
+    touched.push_back(getEntity(entities, contact->GetFixtureB()));
+}
+
+void ContactEvents::BeginContact(b2Contact* contact)
+{
+    record(Type::BEGIN, contact, { 0.0f, 0.0f }, 0.0f);
+    touch(contact);
+}
+
+void ContactEvents::EndContact(b2Contact* contact)
+{
+    record(Type::END, contact, { 0.0f, 0.0f }, 0.0f);
+    touch(contact);
+}
+
+void ContactEvents::PreSolve(b2Contact* contact, const b2Manifold*)
+{
+    touch(contact);
+}
+
+void ContactEvents::PostSolve(b2Contact* contact, const b2ContactImpulse* impulse)
+{
+    float maxImpulse = 0.0f;
+    for (int idx = 0; idx < impulse->count; ++idx)
+    {
+        maxImpulse = std::max(maxImpulse, impulse->normalImpulses[idx]);
+    }
+    if (maxImpulse < impactThreshold) return;
+
+    b2WorldManifold manifold;
+    contact->GetWorldManifold(&manifold);
+    record(Type::IMPACT, contact, { manifold.points[0].x * SCALE_FACTOR, manifold.points[0].y * SCALE_FACTOR }, maxImpulse);
+}
+
+void ContactEvents::sort()
+{
+    // Stable, so the events of one entity keep the order Box2D reported them in.
+    for (std::vector<Event>& typeEvents : events)
+    {
+        std::stable_sort(typeEvents.begin(), typeEvents.end(), [](const Event& left, const Event& right)
+        {
+            return std::tie(left.entity.index, left.entity.generation) < std::tie(right.entity.index, right.entity.generation);
+        });
+    }
+}
+
+std::pair<const ContactEvents::Event*, const ContactEvents::Event*> ContactEvents::find(Type type, EntityHandle handle) const
+{
+    // A slot destroyed and reused within one tick has events under both generations.
+    const std::vector<Event>& typeEvents = getEvents(type);
+    const auto key = std::tie(handle.index, handle.generation);
+    auto firstIt = std::lower_bound(typeEvents.begin(), typeEvents.end(), key, [](const Event& event, const auto& value)
+    {
+        return std::tie(event.entity.index, event.entity.generation) < value;
+    });
+    auto lastIt = std::upper_bound(firstIt, typeEvents.end(), key, [](const auto& value, const Event& event)
+    {
+        return value < std::tie(event.entity.index, event.entity.generation);
+    });
+    return { typeEvents.data() + (firstIt - typeEvents.begin()), typeEvents.data() + (lastIt - typeEvents.begin()) };
+}
+
+void ContactEvents::clear()
+{
+    // Two entries per contact.
+    stats.numBegin = getEvents(Type::BEGIN).size() / 2;
+    stats.numEnd = getEvents(Type::END).size() / 2;
+    stats.numImpacts = getEvents(Type::IMPACT).size() / 2;
+    const std::size_t numTickEvents = stats.numBegin + stats.numEnd + stats.numImpacts;
+    stats.maxPerTick = std::max(stats.maxPerTick, numTickEvents);
+    stats.total += numTickEvents;
+
+    for (std::vector<Event>& typeEvents : events)
+    {
+        typeEvents.clear();
+    }
+}
+
+void ContactEvents::reset()
+{
+    for (std::vector<Event>& typeEvents : events)
+    {
+        typeEvents.clear();
+    }
+    touched.clear();
+    stats = Stats();
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Entity.h"
+#include <box2d/box2d.h>
+#include <SFML/System.hpp>
+#include <utility>
+#include <vector>
+
+// Collects Box2D contact callbacks into per tick arrays. Every contact is
+// stored once for each of its two entities, so after sort() the events of
+// one entity are a contiguous range. The arrays keep their capacity between
+// ticks, recording never allocates once they have grown to the busiest tick.
+class ContactEvents : public b2ContactListener
+{
+public:
+    enum class Type
+    {
+        BEGIN,
+        END,
+        IMPACT
+    };
+
+    struct Event
+    {
+        EntityHandle entity;
+        EntityHandle other;
+
+        // World pixels and the strongest normal impulse, impacts only.
+        sf::Vector2f point;
+        float impulse = 0.0f;
+        bool isSensor = false;
+    };
+
+    struct Stats
+    {
+        std::size_t numBegin = 0;
+        std::size_t numEnd = 0;
+        std::size_t numImpacts = 0;
+        std::size_t maxPerTick = 0;
+        sf::Uint64 total = 0;
+    };
+
+    explicit ContactEvents(const EntityStorage& entities) : entities(entities) {}
+
+    void reserve(std::size_t capacity);
+
+    // Touching contacts report an impact every step, only harder ones are kept.
+    void setImpactThreshold(float impulse) { impactThreshold = impulse; }
+
+    void BeginContact(b2Contact* contact) override;
+    void EndContact(b2Contact* contact) override;
+    void PreSolve(b2Contact* contact, const b2Manifold* oldManifold) override;
+    void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse) override;
+
+    // Groups the events by entity, the lookups below need it.
+    void sort();
+
+    const std::vector<Event>& getEvents(Type type) const { return events[static_cast<std::size_t>(type)]; }
+
+    // Events of one entity as [first, last), valid until clear().
+    std::pair<const Event*, const Event*> find(Type type, EntityHandle handle) const;
+
+    // Ends the tick, updates the counters.
+    void clear();
+
+    // Drops everything including the counters, for level changes.
+    void reset();
+
+    const Stats& getStats() const { return stats; }
+
+    // Both entities of every contact Box2D updated since the last call, may
+    // repeat. Box2D only updates contacts with an awake body and wakes sleeping
+    // bodies through them, so this covers every body a step can wake.
+    const std::vector<EntityHandle>& getTouched() const { return touched; }
+    void clearTouched() { touched.clear(); }
+
+private:
+    void record(Type type, b2Contact* contact, const sf::Vector2f& point, float impulse);
+    void touch(b2Contact* contact);
+
+    const EntityStorage& entities;
+    float impactThreshold = 1.0f;
+
+    std::vector<Event> events[3];
+    std::vector<EntityHandle> touched;
+    Stats stats;
+};
\ No newline at end of file
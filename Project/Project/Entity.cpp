@@ -1,108 +1,560 @@
 #include "Entity.h"
 #include "CommonDefinitions.h"
+#include <algorithm>
+#include <cmath>
 
-Component* Entity::getComponent(Component::Type componentType)
+sf::Transform Archetype::getLocalTransform(std::size_t row) const
 {
-    for (auto& component : components)
+    sf::Transform transform;
+    transform.translate(positions[row]);
+    transform.rotate(rotations[row]);
+    return transform;
+}
+
+void Archetype::removeRow(std::size_t row)
+{
+    auto removeFrom = [row](auto& column)
     {
-        if (component.type == componentType)
+        if (column.empty()) return;
+        if (row + 1 != column.size())
         {
-            return &component;
+            column[row] = std::move(column.back());
         }
+        column.pop_back();
+    };
+
+    removeFrom(entities);
+    removeFrom(positions);
+    removeFrom(rotations);
+    removeFrom(isDirty);
+    removeFrom(worldTransforms);
+    std::apply([&removeFrom](auto&... column) { (removeFrom(column), ...); }, columns);
+}
+
+static void pushComponent(Archetype& archetype, Component& component)
+{
+    std::visit([&archetype](auto& data)
+    {
+        using Data = std::decay_t<decltype(data)>;
+        std::get<std::vector<Data>>(archetype.columns).push_back(std::move(data));
+    }, component.var);
+}
+
+template<std::size_t... INDICES>
+static void moveColumns(Archetype& source, std::size_t row, Archetype& target, std::index_sequence<INDICES...>)
+{
+    auto moveColumn = [&source, &target, row](auto& sourceColumn, auto& targetColumn, Signature bit)
+    {
+        if (source.has(bit) && target.has(bit)) targetColumn.push_back(std::move(sourceColumn[row]));
+    };
+    (moveColumn(std::get<INDICES>(source.columns), std::get<INDICES>(target.columns), Signature(1) << INDICES), ...);
+}
+
+template<std::size_t... INDICES>
+static void takeComponents(Archetype& archetype, std::size_t row, std::vector<Component>& components, std::index_sequence<INDICES...>)
+{
+    auto takeColumn = [&archetype, &components, row](auto& column, Signature bit)
+    {
+        if (!archetype.has(bit)) return;
+        components.emplace_back();
+        components.back().var = std::move(column[row]);
+    };
+    (takeColumn(std::get<INDICES>(archetype.columns), Signature(1) << INDICES), ...);
+}
+
+template<std::size_t... INDICES>
+static void reserveColumns(Archetype& archetype, std::size_t capacity, std::index_sequence<INDICES...>)
+{
+    auto reserveColumn = [&archetype, capacity](auto& column, Signature bit)
+    {
+        if (archetype.has(bit)) column.reserve(capacity);
+    };
+    (reserveColumn(std::get<INDICES>(archetype.columns), Signature(1) << INDICES), ...);
+}
+
+std::uint32_t EntityStorage::getArchetype(Signature signature)
+{
+    auto findIt = archetypeIndex.find(signature);
+    if (findIt != archetypeIndex.end())
+    {
+        return findIt->second;
     }
-    return nullptr;
+
+    const std::uint32_t archetypeIdx = static_cast<std::uint32_t>(archetypes.size());
+    archetypeIndex[signature] = archetypeIdx;
+    archetypes.emplace_back();
+    archetypes.back().signature = signature;
+
+    for (Query& query : queries)
+    {
+        if (query.matches(archetypes.back())) query.archetypes.push_back(archetypeIdx);
+    }
+    return archetypeIdx;
 }
 
-void Entity::update(const sf::Time& elapsedTime)
+QueryId EntityStorage::addQuery(Signature required, Signature excluded)
 {
-    for (auto& component : components)
+    for (QueryId queryIdx = 0; queryIdx < queries.size(); ++queryIdx)
     {
-        switch (component.type)
-        {
-        case Component::Type::BODY:
-        {
-            b2Body* pBody = std::get<b2Body*>(component.var);
-            const b2Vec2 bodyPosition = pBody->GetPosition();
-            setPosition({ (float)meterToPixel(bodyPosition.x), (float)meterToPixel(bodyPosition.y) });
-            setRotation(radianToDegree(pBody->GetAngle()));
-            velocity = pBody->GetLinearVelocity();
-        }
-        break;
+        if (queries[queryIdx].required == required && queries[queryIdx].excluded == excluded) return queryIdx;
+    }
+
+    Query query;
+    query.required = required;
+    query.excluded = excluded;
+    for (std::uint32_t archetypeIdx = 0; archetypeIdx < archetypes.size(); ++archetypeIdx)
+    {
+        if (query.matches(archetypes[archetypeIdx])) query.archetypes.push_back(archetypeIdx);
+    }
+    queries.push_back(std::move(query));
+    return queries.size() - 1;
+}
+
+std::size_t EntityStorage::count(QueryId query) const
+{
+    std::size_t numEntities = 0;
+    for (std::uint32_t archetypeIdx : queries[query].archetypes)
+    {
+        numEntities += archetypes[archetypeIdx].size();
+    }
+    return numEntities;
+}
+
+void EntityStorage::moveEntity(EntityHandle handle, std::uint32_t targetIndex)
+{
+    Slot& slot = slots[handle.index];
+    Archetype& source = archetypes[slot.archetype];
+    Archetype& target = archetypes[targetIndex];
+    const std::uint32_t row = slot.row;
+
+    target.entities.push_back(handle);
+    target.positions.push_back(source.positions[row]);
+    target.rotations.push_back(source.rotations[row]);
+    target.isDirty.push_back(source.isDirty[row]);
+    target.worldTransforms.push_back(source.worldTransforms[row]);
+    moveColumns(source, row, target, std::make_index_sequence<std::variant_size_v<ComponentData>>());
+
+    source.removeRow(row);
+    if (row < source.size())
+    {
+        slots[source.entities[row].index].row = row;
+    }
 
-        case Component::Type::SHAPE:
+    slot.archetype = targetIndex;
+    slot.row = static_cast<std::uint32_t>(target.size() - 1);
+    slot.signature = target.signature;
+}
+
+bool EntityStorage::setActive(EntityHandle handle, bool isActive)
+{
+    if (!isAlive(handle)) return false;
+
+    const Signature signature = slots[handle.index].signature;
+    const Signature target = isActive ? (signature & ~INACTIVE) : (signature | INACTIVE);
+    if (target != signature) moveEntity(handle, getArchetype(target));
+    return true;
+}
+
+bool EntityStorage::addComponent(EntityHandle handle, Component component)
+{
+    if (!isAlive(handle)) return false;
+
+    const Signature bit = signatureOf(component.getType());
+    if ((slots[handle.index].signature & bit) != 0)
+    {
+        const Slot& slot = slots[handle.index];
+        std::visit([this, &slot](auto& data)
         {
-            sf::RectangleShape& shape = std::get<sf::RectangleShape>(component.var);
-        }
-        break;
+            using Data = std::decay_t<decltype(data)>;
+            std::get<std::vector<Data>>(archetypes[slot.archetype].columns)[slot.row] = std::move(data);
+        }, component.var);
+        return true;
+    }
+
+    // Look the target up first, creating it may reallocate the archetype table.
+    const std::uint32_t targetIndex = getArchetype(slots[handle.index].signature | bit);
+    moveEntity(handle, targetIndex);
+    pushComponent(archetypes[targetIndex], component);
+    return true;
+}
+
+bool EntityStorage::removeComponent(EntityHandle handle, Component::Type type)
+{
+    if (!isAlive(handle)) return false;
+
+    const Signature bit = signatureOf(type);
+    if ((slots[handle.index].signature & bit) == 0) return false;
+
+    const std::uint32_t targetIndex = getArchetype(slots[handle.index].signature & ~bit);
+    moveEntity(handle, targetIndex);
+    return true;
+}
+
+EntityHandle EntityStorage::create(EntityDesc desc)
+{
+    return createFrom(desc);
+}
+
+void EntityStorage::reserve(Signature signature, std::size_t count)
+{
+    Archetype& archetype = archetypes[getArchetype(signature)];
+    const std::size_t capacity = archetype.size() + count;
+    archetype.entities.reserve(capacity);
+    archetype.positions.reserve(capacity);
+    archetype.rotations.reserve(capacity);
+    archetype.isDirty.reserve(capacity);
+    archetype.worldTransforms.reserve(capacity);
+    reserveColumns(archetype, capacity, std::make_index_sequence<std::variant_size_v<ComponentData>>());
+    slots.reserve(slots.size() + count);
+}
+
+EntityHandle EntityStorage::createFrom(EntityDesc& desc)
+{
+    // An archetype holds one component per type, extra ones are dropped.
+    Signature signature = 0;
+    auto lastIt = std::remove_if(desc.components.begin(), desc.components.end(), [&signature](const Component& component)
+    {
+        const Signature bit = signatureOf(component.getType());
+        const bool isDuplicate = (signature & bit) != 0;
+        signature |= bit;
+        return isDuplicate;
+    });
+    if (lastIt != desc.components.end())
+    {
+        LOG_ERROR(std::string("duplicate components dropped: ") + desc.name);
+        desc.components.erase(lastIt, desc.components.end());
+    }
+
+    const std::uint32_t archetypeIdx = getArchetype(signature);
+    Archetype& archetype = archetypes[archetypeIdx];
+
+    EntityHandle handle;
+    if (!freeSlots.empty())
+    {
+        handle.index = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        handle.index = static_cast<std::uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+
+    Slot& slot = slots[handle.index];
+    slot.archetype = archetypeIdx;
+    slot.row = static_cast<std::uint32_t>(archetype.size());
+    slot.signature = signature;
+    slot.name = std::move(desc.name);
+    slot.drawOrder = nextDrawOrder++;
+    handle.generation = slot.generation;
+    if (!slot.name.empty()) nameIndex.emplace(slot.name, handle);
+    ++numAlive;
+
+    archetype.entities.push_back(handle);
+    archetype.positions.push_back(desc.position);
+    archetype.rotations.push_back(desc.rotation);
+    archetype.isDirty.push_back(0);
+    archetype.worldTransforms.push_back(archetype.getLocalTransform(archetype.size() - 1));
+    for (Component& component : desc.components)
+    {
+        pushComponent(archetype, component);
+    }
+
+    slot.parent = INVALID_ENTITY;
+    slot.children.clear();
+    slot.depth = 0;
+    if (desc.parent != INVALID_ENTITY) setParent(handle, desc.parent);
+    markDirty(handle);
+    return handle;
+}
+
+bool EntityStorage::destroy(EntityHandle handle)
+{
+    if (!isAlive(handle)) return false;
+
+    // Children outlive their parent as roots, placed where they last were in the world.
+    detach(handle);
+    while (!slots[handle.index].children.empty())
+    {
+        const EntityHandle child = slots[handle.index].children.back();
+        const Slot& childSlot = slots[child.index];
+        Archetype& childArchetype = archetypes[childSlot.archetype];
+        const float* world = childArchetype.worldTransforms[childSlot.row].getMatrix();
+        childArchetype.positions[childSlot.row] = sf::Vector2f(world[12], world[13]);
+        childArchetype.rotations[childSlot.row] = radianToDegree(std::atan2(world[1], world[0]));
+        setParent(child, INVALID_ENTITY);
+    }
+
+    Slot& slot = slots[handle.index];
+    Archetype& archetype = archetypes[slot.archetype];
+    const std::uint32_t row = slot.row;
+    archetype.removeRow(row);
+    if (row < archetype.size())
+    {
+        slots[archetype.entities[row].index].row = row;
+    }
+
+    auto nameIt = nameIndex.find(slot.name);
+    if (nameIt != nameIndex.end() && nameIt->second == handle)
+    {
+        nameIndex.erase(nameIt);
+    }
+
+    slot.archetype = FREE_SLOT;
+    slot.signature = 0;
+    slot.name.clear();
+    ++slot.generation;
+    freeSlots.push_back(handle.index);
+    --numAlive;
+    return true;
+}
+
+bool EntityStorage::destroy(EntityHandle handle, std::vector<Component>& components)
+{
+    if (!isAlive(handle)) return false;
+
+    const Slot& slot = slots[handle.index];
+    components.clear();
+    takeComponents(archetypes[slot.archetype], slot.row, components, std::make_index_sequence<std::variant_size_v<ComponentData>>());
+    return destroy(handle);
+}
+
+bool EntityStorage::isAlive(EntityHandle handle) const
+{
+    return handle.index < slots.size()
+        && slots[handle.index].generation == handle.generation
+        && slots[handle.index].archetype != FREE_SLOT;
+}
+
+void EntityStorage::detach(EntityHandle handle)
+{
+    Slot& slot = slots[handle.index];
+    if (slot.parent == INVALID_ENTITY) return;
+
+    std::vector<EntityHandle>& siblings = slots[slot.parent.index].children;
+    siblings.erase(std::find(siblings.begin(), siblings.end(), handle));
+    slot.parent = INVALID_ENTITY;
+}
 
-        case Component::Type::SPRITE:
+void EntityStorage::setDepth(EntityHandle root, std::uint32_t depth)
+{
+    transformStack.clear();
+    slots[root.index].depth = depth;
+    transformStack.push_back(root);
+    while (!transformStack.empty())
+    {
+        const Slot& slot = slots[transformStack.back().index];
+        transformStack.pop_back();
+        for (EntityHandle child : slot.children)
         {
-            sf::Sprite& sprite = std::get<sf::Sprite>(component.var);
+            slots[child.index].depth = slot.depth + 1;
+            transformStack.push_back(child);
         }
-        break;
+    }
+}
 
-        case Component::Type::ANIMATION:
+bool EntityStorage::setParent(EntityHandle child, EntityHandle parent)
+{
+    if (!isAlive(child)) return false;
+    if (parent != INVALID_ENTITY)
+    {
+        if (!isAlive(parent)) return false;
+        for (EntityHandle ancestor = parent; ancestor != INVALID_ENTITY; ancestor = slots[ancestor.index].parent)
         {
-            Animation& animation = std::get<Animation>(component.var);
-            animation.update(velocity);
+            if (ancestor == child) return false;
         }
-        break;
-        case Component::Type::CAMERA:
+    }
+
+    detach(child);
+    if (parent != INVALID_ENTITY)
+    {
+        slots[child.index].parent = parent;
+        slots[parent.index].children.push_back(child);
+    }
+    setDepth(child, (parent != INVALID_ENTITY) ? slots[parent.index].depth + 1 : 0);
+    markDirty(child);
+    return true;
+}
+
+void EntityStorage::setLocalTransform(EntityHandle handle, const sf::Vector2f& position, float rotation)
+{
+    if (!isAlive(handle)) return;
+
+    const Slot& slot = slots[handle.index];
+    Archetype& archetype = archetypes[slot.archetype];
+    archetype.positions[slot.row] = position;
+    archetype.rotations[slot.row] = rotation;
+    markDirty(handle);
+}
+
+const std::string& EntityStorage::getName(EntityHandle handle) const
+{
+    static const std::string noName;
+    return isAlive(handle) ? slots[handle.index].name : noName;
+}
+
+const std::vector<EntityHandle>& EntityStorage::getChildren(EntityHandle handle) const
+{
+    static const std::vector<EntityHandle> noChildren;
+    return isAlive(handle) ? slots[handle.index].children : noChildren;
+}
+
+void EntityStorage::markDirty(EntityHandle handle)
+{
+    if (!isAlive(handle)) return;
+
+    const Slot& slot = slots[handle.index];
+    std::uint8_t& isDirty = archetypes[slot.archetype].isDirty[slot.row];
+    if (isDirty != 2)
+    {
+        isDirty = 2;
+        dirtyEntities.push_back(handle);
+    }
+}
+
+void EntityStorage::updateTransforms(const std::vector<EntityHandle>& moving, std::vector<EntityHandle>& changed)
+{
+    for (EntityHandle handle : moving)
+    {
+        if (!isAlive(handle)) continue;
+
+        // 1 - flagged by a system, 2 - already listed by markDirty.
+        const Slot& slot = slots[handle.index];
+        std::uint8_t& isDirty = archetypes[slot.archetype].isDirty[slot.row];
+        if (isDirty == 1)
         {
-            GAME_INSTANCE.scene.setCamera(getTransform(), std::get<sf::View>(component.var));
+            isDirty = 2;
+            dirtyEntities.push_back(handle);
         }
-        break;
-        case Component::Type::CONTROLLER:
+    }
+    if (dirtyEntities.empty()) return;
+
+    auto lastIt = std::remove_if(dirtyEntities.begin(), dirtyEntities.end(), [this](EntityHandle handle) { return !isAlive(handle); });
+    dirtyEntities.erase(lastIt, dirtyEntities.end());
+    std::sort(dirtyEntities.begin(), dirtyEntities.end(), [this](EntityHandle left, EntityHandle right)
+    {
+        return slots[left.index].depth < slots[right.index].depth;
+    });
+
+    ++updateStamp;
+    for (EntityHandle dirtyHandle : dirtyEntities)
+    {
+        // Already refreshed as a descendant of an earlier dirty entity.
+        if (slots[dirtyHandle.index].updateStamp == updateStamp) continue;
+
+        transformStack.clear();
+        transformStack.push_back(dirtyHandle);
+        while (!transformStack.empty())
         {
-            ControlActions& controls = std::get<ControlActions>(component.var);
-            for (auto& [key, actions] : controls)
+            const EntityHandle handle = transformStack.back();
+            transformStack.pop_back();
+
+            Slot& slot = slots[handle.index];
+            slot.updateStamp = updateStamp;
+            Archetype& archetype = archetypes[slot.archetype];
+
+            sf::Transform world = archetype.getLocalTransform(slot.row);
+            const bool followsParent = slot.parent != INVALID_ENTITY && !archetype.has(signatureOf(Component::Type::BODY));
+            if (followsParent)
             {
-                for (auto& action : actions) action(*this, sf::Keyboard::isKeyPressed(key));
+                const Slot& parentSlot = slots[slot.parent.index];
+                world = archetypes[parentSlot.archetype].worldTransforms[parentSlot.row] * world;
             }
-        }
-        break;
+            archetype.worldTransforms[slot.row] = world;
+            archetype.isDirty[slot.row] = 0;
+            changed.push_back(handle);
 
+            for (EntityHandle child : slot.children) transformStack.push_back(child);
         }
     }
+    dirtyEntities.clear();
+}
+
+bool EntityStorage::getLocation(EntityHandle handle, std::uint32_t& archetypeIdx, std::uint32_t& row) const
+{
+    if (!isAlive(handle)) return false;
+
+    archetypeIdx = slots[handle.index].archetype;
+    row = slots[handle.index].row;
+    return true;
+}
+
+EntityHandle EntityStorage::getHandle(std::uint32_t index) const
+{
+    if (index >= slots.size() || slots[index].archetype == FREE_SLOT) return INVALID_ENTITY;
+    return { index, slots[index].generation };
 }
 
-void Entity::draw(sf::RenderTarget& target, sf::RenderStates states) const
+EntityHandle EntityStorage::find(const std::string& name) const
 {
-    for (auto& component : components)
+    auto findIt = nameIndex.find(name);
+    return (findIt != nameIndex.end()) ? findIt->second : INVALID_ENTITY;
+}
+
+bool EntityStorage::reserveSlot(EntityHandle handle)
+{
+    while (slots.size() <= handle.index)
     {
-        sf::RenderStates renderState = states;
-        renderState.transform *= getTransform();
+        freeSlots.insert(freeSlots.begin(), static_cast<std::uint32_t>(slots.size()));
+        slots.emplace_back();
+    }
 
-        switch (component.type)
-        {
-            renderState.transform *= component.getTransform();
-        case Component::Type::BODY:
-        {
-            b2Body* pBody = std::get<b2Body*>(component.var);
-            break;
-        }
+    auto findIt = std::find(freeSlots.begin(), freeSlots.end(), handle.index);
+    if (findIt == freeSlots.end()) return false;
 
-        case Component::Type::SHAPE:
-        {
-            const sf::RectangleShape& shape = std::get<sf::RectangleShape>(component.var);
-            target.draw(shape, renderState);
-            break;
-        }
+    std::iter_swap(findIt, freeSlots.end() - 1);
+    slots[handle.index].generation = handle.generation;
+    return true;
+}
 
-        case Component::Type::SPRITE:
-        {
-            const sf::Sprite& sprite = std::get<sf::Sprite>(component.var);
-            target.draw(sprite, renderState);
-            break;
-        }
+bool EntityStorage::restoreSlots(const std::vector<std::uint32_t>& generations, const std::vector<std::uint32_t>& freeOrder)
+{
+    for (std::size_t index = generations.size(); index < slots.size(); ++index)
+    {
+        if (slots[index].archetype != FREE_SLOT) return false;
+    }
+    for (std::uint32_t index : freeOrder)
+    {
+        if (index >= generations.size() || slots[index].archetype != FREE_SLOT) return false;
+    }
 
-        case Component::Type::ANIMATION:
-        {
-            const Animation& animation = std::get<Animation>(component.var);
-            target.draw(animation, renderState);
-            break;
-        }
+    slots.resize(std::min(slots.size(), generations.size()));
+    while (slots.size() < generations.size()) slots.emplace_back();
+    for (std::uint32_t index : freeOrder)
+    {
+        slots[index].generation = generations[index];
+    }
+    freeSlots = freeOrder;
+    return true;
+}
 
+void EntityStorage::clear()
+{
+    archetypes.clear();
+    archetypeIndex.clear();
+    nameIndex.clear();
+    dirtyEntities.clear();
+    nextDrawOrder = 0;
+    for (Query& query : queries)
+    {
+        query.archetypes.clear();
+    }
+
+    // Keep the slots so their generations survive and old handles stay stale.
+    freeSlots.clear();
+    for (std::size_t idx = slots.size(); idx > 0; --idx)
+    {
+        Slot& slot = slots[idx - 1];
+        if (slot.archetype != FREE_SLOT)
+        {
+            slot.archetype = FREE_SLOT;
+            slot.signature = 0;
+            slot.name.clear();
+            slot.parent = INVALID_ENTITY;
+            slot.children.clear();
+            ++slot.generation;
         }
+        freeSlots.push_back(static_cast<std::uint32_t>(idx - 1));
     }
-}
+    numAlive = 0;
+}
\ No newline at end of file
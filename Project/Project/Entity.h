@@ -3,19 +3,54 @@
 #include "Animation.h"
 #include <SFML/Graphics.hpp>
 #include <string>
-#include <array>
+#include <vector>
+#include <tuple>
 #include <variant>
-#include <optional>
+#include <limits>
+#include <cstdint>
 #include <box2d/box2d.h>
 #include <unordered_map>
 #include <functional>
 
-struct Entity;
-using Action = std::function<void(Entity&, bool)>;
+struct Scene;
+
+// Slot index plus the generation the slot had when the handle was made.
+// Destroying an entity bumps the generation, so stale handles stop resolving.
+struct EntityHandle
+{
+    std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t generation = 0;
+
+    bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+};
+
+static constexpr EntityHandle INVALID_ENTITY = {};
+
+using Action = std::function<void(Scene&, EntityHandle, bool)>;
 using ActionList = std::vector<Action>;
 using ControlActions = std::map<sf::Keyboard::Key, ActionList>;
 
-struct Component : public sf::Transformable
+struct BodyState
+{
+    b2Vec2 position = { 0.0f, 0.0f };
+    float angle = 0.0f;
+};
+
+struct Body
+{
+    b2Body* pBody = nullptr;
+    b2Vec2 velocity = { 0.0f, 0.0f };
+
+    // Body state after the last two simulation ticks, blended on render.
+    BodyState previousState;
+    BodyState currentState;
+};
+
+// Alternatives are listed in Component::Type order.
+using ComponentData = std::variant<Body, sf::RectangleShape, sf::Sprite, Animation, sf::View, ControlActions>;
+
+struct Component
 {
     enum class Type
     {
@@ -27,24 +62,271 @@ struct Component : public sf::Transformable
         CONTROLLER
     };
 
-    Component() = default;
-    Component(const Component&) = default;
-    Component& operator=(const Component&) = default;
+    Type getType() const { return static_cast<Type>(var.index()); }
 
-    Type type;
-    std::variant<b2Body*, sf::RectangleShape, sf::Sprite, Animation, sf::View, ControlActions, sf::Text> var;
+    ComponentData var;
 };
 
-struct Entity : public sf::Drawable, public sf::Transformable
+template<Component::Type TYPE>
+using ComponentOf = std::variant_alternative_t<static_cast<std::size_t>(TYPE), ComponentData>;
+
+// One bit per Component::Type.
+using Signature = std::uint32_t;
+
+static constexpr Signature signatureOf(Component::Type type) { return 1u << static_cast<unsigned>(type); }
+
+template<typename... Types>
+static constexpr Signature signatureOf(Component::Type type, Types... types) { return signatureOf(type) | signatureOf(types...); }
+
+// Set on entities parked by level streaming, queries skip their archetypes.
+static constexpr Signature INACTIVE = Signature(1) << 26;
+
+// Everything known about an entity before it is placed into storage.
+struct EntityDesc
 {
     std::string name;
-    b2Vec2 velocity;
+    std::vector<Component> components;
+
+    // Relative to the parent, bodies ignore the parent and follow physics.
+    sf::Vector2f position;
+    float rotation = 0.0f;
+    EntityHandle parent;
+};
 
-    void update(const sf::Time& elapsedTime);
+template<typename Variant> struct ColumnsOf;
+template<typename... Types> struct ColumnsOf<std::variant<Types...>> { using type = std::tuple<std::vector<Types>...>; };
 
-    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+// All entities sharing one set of component types. Every component kind lives
+// in its own contiguous column, row N of every column belongs to entities[N].
+// Columns of types missing from the signature stay empty.
+struct Archetype
+{
+    template<Component::Type TYPE>
+    std::vector<ComponentOf<TYPE>>& column() { return std::get<static_cast<std::size_t>(TYPE)>(columns); }
 
-    Component* getComponent(Component::Type componentType);
+    template<Component::Type TYPE>
+    const std::vector<ComponentOf<TYPE>>& column() const { return std::get<static_cast<std::size_t>(TYPE)>(columns); }
 
-    std::vector<Component> components;
-};
\ No newline at end of file
+    bool has(Signature required) const { return (signature & required) == required; }
+
+    std::size_t size() const { return entities.size(); }
+
+    // Cached world transform, valid after EntityStorage::updateTransforms.
+    const sf::Transform& getTransform(std::size_t row) const { return worldTransforms[row]; }
+
+    sf::Transform getLocalTransform(std::size_t row) const;
+
+    // Moves the last row into the removed one, callers fix up its slot.
+    void removeRow(std::size_t row);
+
+    Signature signature = 0;
+
+    std::vector<EntityHandle> entities;
+
+    // Local transform, systems that write it set isDirty to 1 for the row.
+    std::vector<sf::Vector2f> positions;
+    std::vector<float> rotations;
+    std::vector<std::uint8_t> isDirty;
+    std::vector<sf::Transform> worldTransforms;
+
+    ColumnsOf<ComponentData>::type columns;
+};
+
+using QueryId = std::size_t;
+
+class EntityStorage
+{
+public:
+    EntityHandle create(EntityDesc desc);
+
+    // Moves the component values out of desc, its vectors keep their capacity
+    // so pooled descriptions can be refilled without allocating.
+    EntityHandle createFrom(EntityDesc& desc);
+
+    // Grows the columns of the archetype ahead of a batch of creates.
+    void reserve(Signature signature, std::size_t count);
+
+    // Both move the entity to the archetype of its new signature.
+    // Adding a component the entity already has replaces it.
+    bool addComponent(EntityHandle handle, Component component);
+    bool removeComponent(EntityHandle handle, Component::Type type);
+
+    // Returns false for handles that are already stale.
+    bool destroy(EntityHandle handle);
+
+    // Same, but the components are moved into components instead of being destroyed.
+    bool destroy(EntityHandle handle, std::vector<Component>& components);
+
+    bool isAlive(EntityHandle handle) const;
+
+    // Handle of the live entity in a slot, INVALID_ENTITY for free slots.
+    EntityHandle getHandle(std::uint32_t index) const;
+
+    // O(1), names are expected to be unique within a level. Unnamed entities are not indexed.
+    EntityHandle find(const std::string& name) const;
+
+    // Empty for stale handles.
+    const std::string& getName(EntityHandle handle) const;
+
+    // Fails for stale handles and when the parent is the entity or one of its descendants.
+    // An invalid parent makes the entity a root again.
+    bool setParent(EntityHandle child, EntityHandle parent);
+    EntityHandle getParent(EntityHandle handle) const { return isAlive(handle) ? slots[handle.index].parent : INVALID_ENTITY; }
+
+    // Empty for stale handles.
+    const std::vector<EntityHandle>& getChildren(EntityHandle handle) const;
+
+    void setLocalTransform(EntityHandle handle, const sf::Vector2f& position, float rotation);
+
+    // Not thread safe, parallel systems set Archetype::isDirty instead.
+    void markDirty(EntityHandle handle);
+
+    // Recomputes the world transform of every dirty entity and of all its
+    // descendants, parents first. Rows flagged with isDirty are picked up from
+    // the moving entities only, stale handles are skipped. Appends each updated
+    // entity to changed.
+    void updateTransforms(const std::vector<EntityHandle>& moving, std::vector<EntityHandle>& changed);
+
+    // Archetype index and row of a live entity, both shift as entities move.
+    bool getLocation(EntityHandle handle, std::uint32_t& archetypeIdx, std::uint32_t& row) const;
+
+    // Creation sequence, later entities draw on top. Unlike rows it never
+    // changes while the entity lives.
+    std::uint64_t getDrawOrder(EntityHandle handle) const { return isAlive(handle) ? slots[handle.index].drawOrder : 0; }
+
+    Signature getSignature(EntityHandle handle) const { return isAlive(handle) ? slots[handle.index].signature : 0; }
+
+    // Null for stale handles and missing components.
+    template<Component::Type TYPE>
+    ComponentOf<TYPE>* getComponent(EntityHandle handle);
+
+    template<Component::Type TYPE>
+    const ComponentOf<TYPE>* getComponent(EntityHandle handle) const
+    {
+        return const_cast<EntityStorage*>(this)->getComponent<TYPE>(handle);
+    }
+
+    // Registers the archetype list for every archetype holding at least the
+    // required components and none of the excluded bits. New archetypes are
+    // appended to matching queries as they appear, so iterating never rescans
+    // the archetype table.
+    QueryId addQuery(Signature required, Signature excluded = INACTIVE);
+
+    // Moves the entity in or out of the INACTIVE archetypes, its components stay.
+    bool setActive(EntityHandle handle, bool isActive);
+    bool isActive(EntityHandle handle) const { return isAlive(handle) && (slots[handle.index].signature & INACTIVE) == 0; }
+
+    // Calls func(archetype) for every non-empty archetype matching the query.
+    template<typename Func>
+    void forEach(QueryId query, Func func);
+
+    template<typename Func>
+    void forEach(QueryId query, Func func) const;
+
+    // Entities currently matching the query.
+    std::size_t count(QueryId query) const;
+
+    // Slot table as seen by scene state snapshots.
+    std::uint32_t getNumSlots() const { return static_cast<std::uint32_t>(slots.size()); }
+    std::uint32_t getGeneration(std::uint32_t index) const { return slots[index].generation; }
+    const std::vector<std::uint32_t>& getFreeSlots() const { return freeSlots; }
+
+    // Makes the next create hand out exactly this handle, false while its slot is taken.
+    bool reserveSlot(EntityHandle handle);
+
+    // Puts back the generations of free slots and the order they are handed out in.
+    // Slots past generations are dropped, they must be free.
+    bool restoreSlots(const std::vector<std::uint32_t>& generations, const std::vector<std::uint32_t>& freeOrder);
+
+    // In creation order, which is also the draw order.
+    const std::vector<Archetype>& getArchetypes() const { return archetypes; }
+
+    // For systems writing rows found through getLocation, no structural changes.
+    Archetype& getArchetypeAt(std::uint32_t archetypeIdx) { return archetypes[archetypeIdx]; }
+
+    std::size_t size() const { return numAlive; }
+
+    // Invalidates every handle given out so far.
+    void clear();
+
+private:
+    static constexpr std::uint32_t FREE_SLOT = std::numeric_limits<std::uint32_t>::max();
+
+    struct Slot
+    {
+        std::uint32_t archetype = FREE_SLOT;
+        std::uint32_t row = 0;
+        std::uint32_t generation = 0;
+        Signature signature = 0;
+        std::string name;
+
+        EntityHandle parent;
+        std::vector<EntityHandle> children;
+        std::uint32_t depth = 0;
+        std::uint32_t updateStamp = 0;
+        std::uint64_t drawOrder = 0;
+    };
+
+    struct Query
+    {
+        Signature required = 0;
+        Signature excluded = 0;
+        std::vector<std::uint32_t> archetypes;
+
+        bool matches(const Archetype& archetype) const { return archetype.has(required) && (archetype.signature & excluded) == 0; }
+    };
+
+    std::uint32_t getArchetype(Signature signature);
+
+    // Moves an entity's row to another archetype, keeping the components both share.
+    void moveEntity(EntityHandle handle, std::uint32_t targetIndex);
+
+    std::vector<Archetype> archetypes;
+    std::unordered_map<Signature, std::uint32_t> archetypeIndex;
+
+    std::vector<Query> queries;
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> freeSlots;
+    std::size_t numAlive = 0;
+    std::uint64_t nextDrawOrder = 0;
+
+    std::unordered_map<std::string, EntityHandle> nameIndex;
+
+    void setDepth(EntityHandle root, std::uint32_t depth);
+    void detach(EntityHandle handle);
+
+    std::vector<EntityHandle> dirtyEntities;
+    std::vector<EntityHandle> transformStack;
+    std::uint32_t updateStamp = 0;
+};
+
+template<Component::Type TYPE>
+ComponentOf<TYPE>* EntityStorage::getComponent(EntityHandle handle)
+{
+    if (!isAlive(handle)) return nullptr;
+
+    const Slot& slot = slots[handle.index];
+    if ((slot.signature & signatureOf(TYPE)) == 0) return nullptr;
+    return &archetypes[slot.archetype].column<TYPE>()[slot.row];
+}
+
+template<typename Func>
+void EntityStorage::forEach(QueryId query, Func func)
+{
+    for (std::uint32_t archetypeIdx : queries[query].archetypes)
+    {
+        Archetype& archetype = archetypes[archetypeIdx];
+        if (archetype.size() > 0) func(archetype);
+    }
+}
+
+template<typename Func>
+void EntityStorage::forEach(QueryId query, Func func) const
+{
+    for (std::uint32_t archetypeIdx : queries[query].archetypes)
+    {
+        const Archetype& archetype = archetypes[archetypeIdx];
+        if (archetype.size() > 0) func(archetype);
+    }
+}
@@ -0,0 +1,131 @@
+#include "EntityCommands.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+std::size_t EntityCommands::Batch::size() const
+{
+    return destroyed.size() + removed.size() + added.size() + instantiated.size() + spawned.size();
+}
+
+void EntityCommands::Batch::clear()
+{
+    destroyed.clear();
+    removed.clear();
+    added.clear();
+    instantiated.clear();
+    spawned.clear();
+}
+
+void EntityCommands::Buffer::clear()
+{
+    destroyed.clear();
+    removed.clear();
+    added.clear();
+    instantiated.clear();
+    spawned.clear();
+}
+
+EntityCommands::Tag EntityCommands::nextTag()
+{
+    SystemPipeline::Recording& recording = SystemPipeline::getRecording();
+    return Tag{ recording.system, recording.sequence++ };
+}
+
+EntityCommands::Buffer& EntityCommands::getBuffer()
+{
+    const int worker = JobSystem::getCurrentWorker();
+    assert((worker >= 0 || std::this_thread::get_id() == ownerThread) && "EntityCommands recorded from a foreign thread");
+
+    const std::size_t bufferIdx = static_cast<std::size_t>(worker + 1);
+    return buffers[std::min(bufferIdx, buffers.size() - 1)];
+}
+
+void EntityCommands::spawn(EntityDesc desc)
+{
+    getBuffer().spawned.push_back({ nextTag(), std::move(desc) });
+}
+
+void EntityCommands::instantiate(PrefabId prefabId, const SpawnDesc& spawn)
+{
+    getBuffer().instantiated.push_back({ nextTag(), { prefabId, spawn } });
+}
+
+void EntityCommands::destroy(EntityHandle handle)
+{
+    getBuffer().destroyed.push_back({ nextTag(), handle });
+}
+
+void EntityCommands::addComponent(EntityHandle handle, Component component)
+{
+    getBuffer().added.push_back({ nextTag(), { handle, std::move(component) } });
+}
+
+void EntityCommands::removeComponent(EntityHandle handle, Component::Type type)
+{
+    getBuffer().removed.push_back({ nextTag(), { handle, type } });
+}
+
+void EntityCommands::setNumWorkers(int numWorkers)
+{
+    ownerThread = std::this_thread::get_id();
+
+    const std::size_t numBuffers = static_cast<std::size_t>(std::max(numWorkers, 0)) + 1;
+    if (buffers.size() != numBuffers) buffers.resize(numBuffers);
+}
+
+template<typename T>
+static void moveAppend(std::vector<T>& source, std::vector<T>& target)
+{
+    std::move(source.begin(), source.end(), std::back_inserter(target));
+    source.clear();
+}
+
+// Stable, so commands sharing a tag (recorded by parallelFor jobs) keep the order they were gathered in.
+template<typename Entry, typename T>
+static void moveInTagOrder(std::vector<Entry>& gathered, std::vector<T>& target)
+{
+    std::stable_sort(gathered.begin(), gathered.end(), [](const Entry& left, const Entry& right) { return left.tag < right.tag; });
+    for (Entry& entry : gathered)
+    {
+        target.push_back(std::move(entry.value));
+    }
+    gathered.clear();
+}
+
+EntityCommands::Batch& EntityCommands::collect()
+{
+    merged.clear();
+    for (Buffer& buffer : buffers)
+    {
+        moveAppend(buffer.destroyed, gathered.destroyed);
+        moveAppend(buffer.removed, gathered.removed);
+        moveAppend(buffer.added, gathered.added);
+        moveAppend(buffer.instantiated, gathered.instantiated);
+        moveAppend(buffer.spawned, gathered.spawned);
+    }
+
+    // New entities take slots in this order, which the checksum depends on.
+    moveInTagOrder(gathered.destroyed, merged.destroyed);
+    moveInTagOrder(gathered.removed, merged.removed);
+    moveInTagOrder(gathered.added, merged.added);
+    moveInTagOrder(gathered.instantiated, merged.instantiated);
+    moveInTagOrder(gathered.spawned, merged.spawned);
+
+    // Destroyed in slot order, which is also deterministic, and only once.
+    auto byIndex = [](EntityHandle left, EntityHandle right) { return left.index < right.index; };
+    std::stable_sort(merged.destroyed.begin(), merged.destroyed.end(), byIndex);
+    merged.destroyed.erase(std::unique(merged.destroyed.begin(), merged.destroyed.end()), merged.destroyed.end());
+    return merged;
+}
+
+void EntityCommands::clear()
+{
+    for (Buffer& buffer : buffers)
+    {
+        buffer.clear();
+    }
+    gathered.clear();
+    merged.clear();
+}
\ No newline at end of file
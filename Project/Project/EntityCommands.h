@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Entity.h"
+#include "Prefab.h"
+#include "SystemPipeline.h"
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Structural changes requested while systems run. Every job worker records
+// into its own buffer without locking, the main thread records into one more
+// buffer and applies them all at the sync point after the tick, once no
+// system iterates the archetypes.
+class EntityCommands
+{
+public:
+    struct Batch
+    {
+        std::vector<EntityHandle> destroyed;
+        std::vector<std::pair<EntityHandle, Component::Type>> removed;
+        std::vector<std::pair<EntityHandle, Component>> added;
+        std::vector<std::pair<PrefabId, SpawnDesc>> instantiated;
+        std::vector<EntityDesc> spawned;
+
+        std::size_t size() const;
+        void clear();
+    };
+
+    // Safe from any system running on a job worker or on the main thread,
+    // the handle of a new entity is known only after apply.
+    void spawn(EntityDesc desc);
+    void instantiate(PrefabId prefabId, const SpawnDesc& spawn);
+    void destroy(EntityHandle handle);
+    void addComponent(EntityHandle handle, Component component);
+    void removeComponent(EntityHandle handle, Component::Type type);
+
+    // One buffer per job worker plus one for the calling thread, which becomes
+    // the only non-worker thread allowed to record. Main thread only, while no system runs.
+    void setNumWorkers(int numWorkers);
+
+    // Moves every buffer into one batch ordered by the recording system's
+    // pipeline index, then by the order that system recorded in, commands from
+    // outside systems last. Which worker ran a system does not change the
+    // result. Apply it in member order: destroys first, spawns last.
+    Batch& collect();
+
+    void clear();
+
+private:
+    struct Tag
+    {
+        std::uint32_t system = NO_SYSTEM;
+        std::uint32_t sequence = 0;
+
+        bool operator<(const Tag& other) const
+        {
+            return system < other.system || (system == other.system && sequence < other.sequence);
+        }
+    };
+
+    template<typename T>
+    struct Tagged
+    {
+        Tag tag;
+        T value;
+    };
+
+    // Padded so threads recording side by side do not share a cache line.
+    struct alignas(64) Buffer
+    {
+        std::vector<Tagged<EntityHandle>> destroyed;
+        std::vector<Tagged<std::pair<EntityHandle, Component::Type>>> removed;
+        std::vector<Tagged<std::pair<EntityHandle, Component>>> added;
+        std::vector<Tagged<std::pair<PrefabId, SpawnDesc>>> instantiated;
+        std::vector<Tagged<EntityDesc>> spawned;
+
+        void clear();
+    };
+
+    Buffer& getBuffer();
+    static Tag nextTag();
+
+    std::vector<Buffer> buffers = std::vector<Buffer>(1);
+    std::thread::id ownerThread = std::this_thread::get_id();
+
+    // Every buffer gathered before sorting, kept for its capacity.
+    Buffer gathered;
+    Batch merged;
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "FrameGovernor.h"
+
+// Level 0 is full quality, every next level trades more precision for time.
+static const std::array<FrameGovernor::Knobs, 5> QUALITY_LEVELS =
+{{
+    { 50, 50, 1, sf::milliseconds(100) },
+    { 20, 20, 1, sf::milliseconds(200) },
+    { 10,  8, 2, sf::milliseconds(300) },
+    {  8,  3, 3, sf::milliseconds(500) },
+    {  4,  2, 4, sf::milliseconds(1000) }
+}};
+
+bool FrameGovernor::addFrame(const sf::Time& frameCost)
+{
+    if (budget <= sf::Time::Zero) return false;
+
+    costs[costIndex] = frameCost.asMicroseconds();
+    costIndex = (costIndex + 1) % WINDOW_SIZE;
+    if (numCosts < WINDOW_SIZE) ++numCosts;
+
+    if (cooldown > 0)
+    {
+        --cooldown;
+        return false;
+    }
+    if (numCosts < WINDOW_SIZE) return false;
+
+    sf::Int64 sum = 0;
+    for (sf::Int64 cost : costs) sum += cost;
+    const sf::Int64 average = sum / static_cast<sf::Int64>(WINDOW_SIZE);
+    const sf::Int64 budgetMicroseconds = budget.asMicroseconds();
+
+    const int lastLevel = static_cast<int>(QUALITY_LEVELS.size()) - 1;
+    if (average > budgetMicroseconds && level < lastLevel)
+    {
+        ++level;
+        cooldown = DEGRADE_COOLDOWN;
+        return true;
+    }
+    if (average < budgetMicroseconds * 6 / 10 && level > 0)
+    {
+        --level;
+        cooldown = RECOVER_COOLDOWN;
+        return true;
+    }
+    return false;
+}
+
+const FrameGovernor::Knobs& FrameGovernor::getKnobs() const
+{
+    return QUALITY_LEVELS[level];
+}
+
+std::string FrameGovernor::describe() const
+{
+    const Knobs& knobs = getKnobs();
+    return std::string("quality level ") + std::to_string(level)
+        + ": solver " + std::to_string(knobs.velocityIterations) + "/" + std::to_string(knobs.positionIterations)
+        + ", animation every " + std::to_string(knobs.animationInterval) + " ticks"
+        + ", ui refresh " + std::to_string(knobs.uiRefreshInterval.asMilliseconds()) + " ms";
+}
\ No newline at end of file
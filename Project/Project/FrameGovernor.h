@@ -0,0 +1,43 @@
+#pragma once
+
+#include <SFML/System.hpp>
+#include <array>
+#include <string>
+
+// Watches recent frame costs and steps quality down when they exceed the
+// budget, back up once there is comfortable headroom again.
+class FrameGovernor
+{
+public:
+    struct Knobs
+    {
+        int velocityIterations = 50;
+        int positionIterations = 50;
+        int animationInterval = 1;
+        sf::Time uiRefreshInterval = sf::milliseconds(100);
+    };
+
+    void setBudget(const sf::Time& frameBudget) { budget = frameBudget; }
+    const sf::Time& getBudget() const { return budget; }
+
+    // Returns true when the knobs changed.
+    bool addFrame(const sf::Time& frameCost);
+
+    const Knobs& getKnobs() const;
+    int getLevel() const { return level; }
+
+    std::string describe() const;
+
+private:
+    static constexpr std::size_t WINDOW_SIZE = 30;
+    static constexpr int DEGRADE_COOLDOWN = 30;
+    static constexpr int RECOVER_COOLDOWN = 120;
+
+    sf::Time budget;
+    int level = 0;
+    int cooldown = 0;
+
+    std::array<sf::Int64, WINDOW_SIZE> costs = {};
+    std::size_t numCosts = 0;
+    std::size_t costIndex = 0;
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "FrameLimiter.h"
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+void FrameLimiter::setTargetFrameRate(State targetState, int framesPerSecond)
+{
+    const sf::Time frameTime = (framesPerSecond > 0) ? sf::microseconds(1000000 / framesPerSecond) : sf::Time::Zero;
+    targetFrameTime[static_cast<int>(targetState)] = frameTime;
+}
+
+sf::Time FrameLimiter::wait()
+{
+    const sf::Time target = targetFrameTime[static_cast<int>(state)];
+    if (target > sf::Time::Zero)
+    {
+        const sf::Time remaining = target - frameClock.getElapsedTime();
+        if (remaining > spinThreshold)
+        {
+            sf::sleep(remaining - spinThreshold);
+        }
+
+        while (frameClock.getElapsedTime() < target)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    const sf::Time frameTime = frameClock.restart();
+    record(frameTime);
+    return frameTime;
+}
+
+void FrameLimiter::record(const sf::Time& frameTime)
+{
+    history[historyIndex] = frameTime;
+    historyIndex = (historyIndex + 1) % HISTORY_SIZE;
+    historySize = std::min(historySize + 1, HISTORY_SIZE);
+
+    sf::Int64 sum = 0;
+    sf::Int64 worst = 0;
+    for (std::size_t idx = 0; idx < historySize; ++idx)
+    {
+        const sf::Int64 us = history[idx].asMicroseconds();
+        sum += us;
+        worst = std::max(worst, us);
+    }
+    const double mean = static_cast<double>(sum) / historySize;
+
+    double variance = 0.0;
+    for (std::size_t idx = 0; idx < historySize; ++idx)
+    {
+        const double delta = history[idx].asMicroseconds() - mean;
+        variance += delta * delta;
+    }
+    variance /= historySize;
+
+    stats.average = sf::microseconds(static_cast<sf::Int64>(mean));
+    stats.jitter = sf::microseconds(static_cast<sf::Int64>(std::sqrt(variance)));
+    stats.worst = sf::microseconds(worst);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <SFML/System.hpp>
+#include <array>
+
+class FrameLimiter
+{
+public:
+    enum class State
+    {
+        GAMEPLAY,
+        MENU,
+        UNFOCUSED
+    };
+
+    struct Stats
+    {
+        sf::Time average;
+        sf::Time jitter;
+        sf::Time worst;
+    };
+
+    // Zero frames per second leaves the state unlimited (e.g. with v-synch).
+    void setTargetFrameRate(State state, int framesPerSecond);
+
+    // The last part of every wait is spun instead of slept, sleep is too coarse.
+    void setSpinThreshold(const sf::Time& threshold) { spinThreshold = threshold; }
+
+    void setState(State newState) { state = newState; }
+    State getState() const { return state; }
+
+    // Blocks until the current frame has lasted its target time, returns the frame time.
+    sf::Time wait();
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    void record(const sf::Time& frameTime);
+
+    static constexpr std::size_t HISTORY_SIZE = 120;
+
+    std::array<sf::Time, 3> targetFrameTime = {};
+    sf::Time spinThreshold = sf::milliseconds(2);
+    State state = State::GAMEPLAY;
+
+    sf::Clock frameClock;
+
+    std::array<sf::Time, HISTORY_SIZE> history = {};
+    std::size_t historySize = 0;
+    std::size_t historyIndex = 0;
+    Stats stats;
+};
\ No newline at end of file
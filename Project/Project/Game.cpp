@@ -2,6 +2,32 @@
 #include "CommonDefinitions.h"
 #include <optional>
 #include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+// Working set of the process in bytes, false where it is not available.
+static bool getProcessMemory(std::size_t& bytes)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        bytes = counters.WorkingSetSize;
+        return true;
+    }
+#else
+    (void)bytes;
+#endif
+    return false;
+}
 
 Game& Game::getInstance()
 {
@@ -9,12 +35,47 @@ Game& Game::getInstance()
     return instance;
 }
 
-Game::Game() : window(sf::VideoMode(WINDOW_CONFIG.w, WINDOW_CONFIG.h), WINDOW_CONFIG.name, sf::Style::Titlebar | sf::Style::Close)
+Game::Game()
 {
+    JOBS.start(CONFIG.getJobsSettings().workers);
+
+    maxCommandsPerFrame = CONFIG.getCommandsSettings().maxPerFrame;
+
+    const Config::Input input = CONFIG.getInputSettings();
+    if (!input.replay.empty())
+    {
+        INPUT_INSTANCE.startReplay(input.replay);
+    }
+    else if (!input.record.empty())
+    {
+        INPUT_INSTANCE.startRecording(input.record);
+    }
+
+    if (CONFIG.isHeadless())
+    {
+        AudioSystem::getInstance().setEnabled(false);
+        return;
+    }
+
+    window.create(sf::VideoMode(WINDOW_CONFIG.w, WINDOW_CONFIG.h), WINDOW_CONFIG.name, sf::Style::Titlebar | sf::Style::Close);
     window.setVerticalSyncEnabled(WINDOW_CONFIG.vSynch);
+    window.setKeyRepeatEnabled(false);
     window.setTitle(WINDOW_CONFIG.name);
     sf::Image& icon = IMAGE(WINDOW_CONFIG.icon);
     window.setIcon(icon.getSize().x, icon.getSize().y, icon.getPixelsPtr());
+
+    const Config::FrameRate frameRate = CONFIG.getFrameRateSettings();
+    frameLimiter.setTargetFrameRate(FrameLimiter::State::GAMEPLAY, frameRate.gameplay);
+    frameLimiter.setTargetFrameRate(FrameLimiter::State::MENU, frameRate.menu);
+    frameLimiter.setTargetFrameRate(FrameLimiter::State::UNFOCUSED, frameRate.unfocused);
+    frameLimiter.setSpinThreshold(sf::microseconds(frameRate.spinMicroseconds));
+
+    // Physics iterations are part of the simulation, recordings and their
+    // replays have to step at the same quality throughout.
+    if (INPUT_INSTANCE.getMode() == InputSystem::Mode::LIVE)
+    {
+        governor.setBudget(sf::microseconds(CONFIG.getGovernorSettings().budgetMicroseconds));
+    }
 }
 
 void Game::processMessages()
@@ -22,6 +83,7 @@ void Game::processMessages()
     sf::Event event;
     while (window.pollEvent(event))
     {
+        INPUT_INSTANCE.handleEvent(event);
         handleEvent(event);
     }
 }
@@ -34,36 +96,53 @@ void Game::handleEvent(const sf::Event& event)
     break;
 
     case sf::Event::KeyReleased:
+        // Not part of input recordings, so only while playing live.
+        if (INPUT_INSTANCE.getMode() == InputSystem::Mode::LIVE && scene.menuStack.empty())
+        {
+            if (event.key.code == sf::Keyboard::Key::F5) post(Command::Type::QUICK_SAVE);
+            if (event.key.code == sf::Keyboard::Key::F9) post(Command::Type::QUICK_LOAD);
+        }
+
         if (event.key.code == sf::Keyboard::Key::Escape)
         {
             if (scene.menuStack.size() > 0)
             {
-                exec("BACK", {});
+                post(Command::Type::BACK);
             }
             else if (scene.allMenu.count("Game Settings"))
             {
-                exec("MENU", { "Game Settings" });
+                post(Command::Type::MENU, { "Game Settings" });
             }
         }
     break;
 
     case sf::Event::Closed:
-        window.close();
+        close();
+        break;
+
+    case sf::Event::LostFocus:
+        hasFocus = false;
+        break;
+
+    case sf::Event::GainedFocus:
+        hasFocus = true;
         break;
 
     default:
         break;
     }
-    if (event.type == sf::Event::Closed)
-        window.close();
 
     UI_INSTANCE.handleEvent(event);
 }
 
 void Game::update(const sf::Time& elapsedTime)
 {
+    INPUT_INSTANCE.beginTick();
     scene.update(elapsedTime);
+}
 
+void Game::updateUi(const sf::Time& elapsedTime)
+{
     UPDATE_UI(elapsedTime);
 
     const auto& winCfg = WINDOW_CONFIG;
@@ -75,6 +154,42 @@ void Game::update(const sf::Time& elapsedTime)
     windowTitle += "] ";
     windowTitle += (winCfg.vSynch) ? " [v-Synch ON] " : " [v-Synch OFF] ";
     windowTitle += CONFIG.currentLevel;
+
+    const CommandQueue::Stats& commandStats = commands.getStats();
+    windowTitle += " [cmd wait avg/max: ";
+    windowTitle += std::to_string(commandStats.averageWait().asMicroseconds());
+    windowTitle += "/";
+    windowTitle += std::to_string(commandStats.maxWait.asMicroseconds());
+    windowTitle += " us]";
+
+    const InputSystem::LatencyStats latencyStats = INPUT_INSTANCE.getLatencyStats();
+    windowTitle += " [input-to-present avg/max: ";
+    windowTitle += std::to_string(latencyStats.average.asMicroseconds());
+    windowTitle += "/";
+    windowTitle += std::to_string(latencyStats.max.asMicroseconds());
+    windowTitle += " us]";
+
+    windowTitle += " [drawn/culled: ";
+    windowTitle += std::to_string(scene.cullStats.numDrawn);
+    windowTitle += "/";
+    windowTitle += std::to_string(scene.cullStats.numCulled);
+    windowTitle += "]";
+
+    if (scene.streaming.isEnabled())
+    {
+        const LevelStreaming::Stats& streamingStats = scene.streaming.getStats();
+        windowTitle += " [regions active/total: ";
+        windowTitle += std::to_string(streamingStats.numActive);
+        windowTitle += "/";
+        windowTitle += std::to_string(streamingStats.numRegions);
+        windowTitle += "]";
+    }
+
+    windowTitle += " [tick critical/serial: ";
+    windowTitle += std::to_string(scene.tickSystems.getCriticalPath().asMicroseconds());
+    windowTitle += "/";
+    windowTitle += std::to_string(scene.tickSystems.getSerialTime().asMicroseconds());
+    windowTitle += " us]";
     window.setTitle(windowTitle);
 }
 
@@ -87,75 +202,435 @@ void Game::renderFrame(const sf::Time& elapsedTime)
     window.draw(UI_INSTANCE);
 
     window.display();
+    INPUT_INSTANCE.onPresented(INPUT_INSTANCE.takeConsumedInputTime());
+
+    COUNT_RENDER(elapsedTime, frameLimiter.getStats().jitter);
+}
+
+void Game::publishFrame()
+{
+    COUNT_RENDER(sf::microseconds(renderFrameTime), frameLimiter.getStats().jitter);
+
+    RenderSnapshot& snapshot = snapshots.back();
+    snapshot.inputTime = INPUT_INSTANCE.takeConsumedInputTime();
+    scene.capture(snapshot.scene);
+    UI_INSTANCE.capture(snapshot.ui);
+    snapshots.publish();
+}
+
+void Game::startRenderThread()
+{
+    window.setActive(false);
+    snapshots.reset();
+    isRendering = true;
+    renderThread = std::thread(&Game::renderLoop, this);
+}
+
+void Game::stopRenderThread()
+{
+    if (renderThread.joinable())
+    {
+        isRendering = false;
+        renderThread.join();
+        window.setActive(true);
+    }
+}
+
+void Game::renderLoop()
+{
+    window.setActive(true);
+
+    sf::Clock frameClock;
+    while (isRendering)
+    {
+        const RenderSnapshot* pSnapshot = snapshots.acquire(sf::milliseconds(100));
+        if (pSnapshot == nullptr) continue;
 
-    COUNT_RENDER(elapsedTime);
+        sf::Clock workClock;
+        window.clear(sf::Color::Black);
+        window.draw(pSnapshot->scene);
+        window.draw(pSnapshot->ui);
+        window.display();
+        INPUT_INSTANCE.onPresented(pSnapshot->inputTime);
+
+        renderWorkTime = workClock.getElapsedTime().asMicroseconds();
+        renderFrameTime = frameClock.restart().asMicroseconds();
+    }
+
+    window.setActive(false);
+}
+
+void Game::close()
+{
+    stopRenderThread();
+    window.close();
 }
 
 void Game::blockingRun()
 {
+    const Config::Simulation simulation = CONFIG.getSimulationSettings();
+    const sf::Time tickTime = sf::seconds(1.0f / simulation.tickRate);
+    sf::Time accumulator = sf::Time::Zero;
     sf::Time elapsedTime = clock.restart();
 
+    if (CONFIG.getRenderingSettings().threaded)
+    {
+        startRenderThread();
+    }
+
     while (window.isOpen())
     {
-        while (!commands.empty())
-        {
-            const Command& command = commands.front();
-            switch (command.type)
-            {
-            case Command::Type::LOAD:
-                UI_INSTANCE.clearStaticText();
-                scene.clear();
-                CONFIG.loadLevel(command.args.front(), GAME_INSTANCE.scene);
-                break;
-
-            case Command::Type::BACK:
-                if (scene.menuStack.top().name != "Main menu") scene.menuStack.pop();
-                break;
-
-            case Command::Type::EXIT:
-                    scene.clear();
-                    window.close();
-                break;
-
-            case Command::Type::MENU:
-                scene.menuStack.push(scene.allMenu[command.args.front()]);
-                break;
-
-            default:
-                break;
-            }
-            commands.pop();
-        }
+        frameLimiter.setState(getFrameState());
+        frameLimiter.wait();
 
+        // Poll right before the ticks so the snapshot they consume is as fresh as possible.
         elapsedTime = clock.restart();
+        sf::Clock workClock;
         processMessages();
-        update(elapsedTime);
-        renderFrame(elapsedTime);
+        executeCommands();
+
+        accumulator += elapsedTime;
+        int numTicks = 0;
+        while (accumulator >= tickTime && numTicks < simulation.maxTicksPerFrame)
+        {
+            update(tickTime);
+            accumulator -= tickTime;
+            ++numTicks;
+        }
+
+        // Too far behind to catch up: drop the backlog instead of spiralling.
+        if (accumulator >= tickTime)
+        {
+            accumulator %= tickTime;
+        }
+
+        scene.interpolate(accumulator / tickTime);
+        updateUi(elapsedTime);
+
+        if (isRendering)
+        {
+            publishFrame();
+        }
+        else
+        {
+            renderFrame(elapsedTime);
+        }
+
+        // With a render thread the frame costs whichever side is slower.
+        sf::Time frameCost = workClock.getElapsedTime();
+        if (isRendering)
+        {
+            frameCost = std::max(frameCost, sf::microseconds(renderWorkTime));
+        }
+        if (governor.addFrame(frameCost))
+        {
+            applyQuality();
+        }
+    }
+
+    stopRenderThread();
+    INPUT_INSTANCE.stop();
+}
+
+void Game::headlessRun()
+{
+    const Config::Headless headless = CONFIG.getHeadlessSettings();
+    const Config::Simulation simulation = CONFIG.getSimulationSettings();
+    const sf::Time tickTime = sf::seconds(1.0f / simulation.tickRate);
+
+    InputSystem& input = INPUT_INSTANCE;
+    const bool isReplay = (input.getMode() == InputSystem::Mode::REPLAY);
+
+    std::string levelName = headless.level;
+    input.pollReplayLevel(levelName);
+
+    sf::Clock runClock;
+    loadLevel(levelName);
+    const sf::Time loadTime = runClock.restart();
+
+    int numTicks = 0;
+    while (!isExitRequested && (isReplay ? !input.isReplayFinished() : numTicks < headless.ticks))
+    {
+        executeCommands();
+        if (input.pollReplayLevel(levelName))
+        {
+            loadLevel(levelName);
+        }
+        update(tickTime);
+        ++numTicks;
+    }
+    const sf::Time runTime = runClock.getElapsedTime();
+    input.stop();
+
+    const float ticksPerSecond = (runTime > sf::Time::Zero) ? numTicks / runTime.asSeconds() : 0.0f;
+    std::cout << "level: " << CONFIG.currentLevel
+              << " entities: " << scene.entities.size()
+              << " bodies: " << scene.world.GetBodyCount() << "\n"
+              << "load: " << loadTime.asMilliseconds() << " ms"
+              << " ticks: " << numTicks
+              << " run: " << runTime.asMilliseconds() << " ms"
+              << " ticks/s: " << ticksPerSecond
+              << " (" << simulation.tickRate << " Hz realtime)\n"
+              << "checksum: " << std::hex << scene.computeChecksum() << std::dec << "\n";
+
+    const std::vector<JobSystem::WorkerStats> workerStats = JOBS.collectStats();
+    for (std::size_t idx = 0; idx < workerStats.size(); ++idx)
+    {
+        std::cout << "worker " << idx << ": jobs: " << workerStats[idx].numJobs
+                  << " stolen: " << workerStats[idx].numStolen
+                  << " utilization: " << workerStats[idx].utilization * 100.0f << "%\n";
+    }
+
+    for (const System& system : scene.tickSystems.getSystems())
+    {
+        std::cout << "system " << system.name << ": runs: " << system.stats.numRuns
+                  << " skipped: " << system.stats.numSkipped
+                  << " entities: " << system.stats.numEntities
+                  << " avg: " << system.stats.average().asMicroseconds() << " us"
+                  << " max: " << system.stats.max.asMicroseconds() << " us\n";
     }
+    for (const Prefab& prefab : scene.prefabs)
+    {
+        std::cout << "prefab " << prefab.name << ": spawned: " << prefab.stats.numSpawned
+                  << " reused: " << prefab.stats.numReused
+                  << " allocated: " << prefab.stats.numAllocated
+                  << " pooled: " << prefab.numFree << "\n";
+    }
+    const ContactEvents::Stats& contactStats = scene.contacts.getStats();
+    std::cout << "contacts: events: " << contactStats.total
+              << " max per tick: " << contactStats.maxPerTick
+              << " last tick begin/end/impact: " << contactStats.numBegin
+              << "/" << contactStats.numEnd << "/" << contactStats.numImpacts << "\n";
+    std::cout << "bodies: " << scene.entities.count(scene.bodyQuery)
+              << " moving: " << scene.getNumMovingBodies() << "\n";
+    if (scene.streaming.isEnabled())
+    {
+        const LevelStreaming::Stats& streamingStats = scene.streaming.getStats();
+        std::cout << "streaming: regions: " << streamingStats.numRegions
+                  << " active: " << streamingStats.numActive
+                  << " pending: " << streamingStats.numPending << "\n";
+    }
+
+    std::cout << "scene state: " << scene.stateStats.numBytes << " bytes"
+              << " save: " << scene.stateStats.saveTime.asMicroseconds() << " us\n";
+    std::cout << "last tick critical path: " << scene.tickSystems.describeCriticalPath()
+              << " " << scene.tickSystems.getCriticalPath().asMicroseconds() << " us"
+              << " of " << scene.tickSystems.getSerialTime().asMicroseconds() << " us serial\n";
+    std::cout << std::flush;
+
+    if (headless.timeRestore) timeRestore();
+
+    scene.clear();
 }
 
-void Game::exec(const std::string& action, const std::vector<std::string>& args)
+void Game::timeRestore()
 {
-    const std::string LEVEL = "LEVEL";
-    const std::string SETTINGS = "SETTINGS";
-    const std::string EXIT = "EXIT";
-    const std::string MENU = "MENU";
-    const std::string BACK = "BACK";
+    if (!scene.restoreState(levelStart))
+    {
+        std::cout << "restore: failed\n" << std::flush;
+        return;
+    }
+    std::cout << "restore: " << scene.stateStats.restoreTime.asMicroseconds() << " us\n" << std::flush;
+}
+
+void Game::benchmarkRun()
+{
+    const Config::Benchmark benchmark = CONFIG.getBenchmarkSettings();
+    const Config::Simulation simulation = CONFIG.getSimulationSettings();
+    const sf::Time tickTime = sf::seconds(1.0f / simulation.tickRate);
+
+    struct Result
+    {
+        int scale = 0;
+        std::size_t numEntities = 0;
+        sf::Time loadTime;
+        sf::Time saveTime;
+        sf::Time tickTime;
+        sf::Time frameTime;
+        bool hasMemory = false;
+        std::size_t memory = 0;
+    };
+
+    auto printMemory = [](const Result& result)
+    {
+        if (result.hasMemory) std::cout << result.memory / 1024;
+        else std::cout << "n/a";
+    };
+    std::vector<Result> results;
 
-    if (action == EXIT)
+    auto printSystems = [](const SystemPipeline& pipeline)
     {
-        commands.push({ Command::Type::EXIT, args });
+        for (const System& system : pipeline.getSystems())
+        {
+            std::cout << "  system " << system.name << ": entities: " << system.stats.numEntities
+                      << " avg: " << system.stats.average().asMicroseconds() << " us"
+                      << " max: " << system.stats.max.asMicroseconds() << " us\n";
+        }
+    };
+
+    for (int scale : benchmark.scales)
+    {
+        scene.clear();
+        std::size_t memoryBefore = 0;
+        const bool hasMemoryBefore = getProcessMemory(memoryBefore);
+
+        // Every size is parsed from scratch, not restored. The level start
+        // snapshot is timed on its own so load stays the parse alone.
+        CONFIG.setRepeatScale(scale);
+        sf::Clock clock;
+        parseLevel(benchmark.level);
+
+        Result result;
+        result.scale = scale;
+        result.loadTime = clock.restart();
+        result.numEntities = scene.entities.size();
+
+        // Growth over the emptied scene, freed pages are not always returned at once.
+        std::size_t memoryAfter = 0;
+        result.hasMemory = hasMemoryBefore && getProcessMemory(memoryAfter);
+        result.memory = (result.hasMemory && memoryAfter > memoryBefore) ? memoryAfter - memoryBefore : 0;
+
+        levelStart = SceneState();
+        levelStart.level = benchmark.level;
+        clock.restart();
+        scene.saveState(levelStart);
+        result.saveTime = clock.restart();
+        levelStartMenus = scene.menuStack;
+
+        scene.tickSystems.resetStats();
+        scene.frameSystems.resetStats();
+        for (int tick = 0; tick < benchmark.ticks; ++tick)
+        {
+            clock.restart();
+            update(tickTime);
+            result.tickTime += clock.restart();
+            scene.interpolate(1.0f);
+            result.frameTime += clock.restart();
+        }
+        result.tickTime /= static_cast<sf::Int64>(std::max(benchmark.ticks, 1));
+        result.frameTime /= static_cast<sf::Int64>(std::max(benchmark.ticks, 1));
+        results.push_back(result);
+
+        std::cout << "scale " << scale << ": entities: " << result.numEntities
+                  << " bodies: " << scene.world.GetBodyCount()
+                  << " moving: " << scene.getNumMovingBodies()
+                  << " load: " << result.loadTime.asMilliseconds() << " ms"
+                  << " memory: ";
+        printMemory(result);
+        std::cout << " KB state: " << scene.stateStats.numBytes / 1024 << " KB"
+                  << " save: " << result.saveTime.asMicroseconds() << " us\n";
+        printSystems(scene.tickSystems);
+        printSystems(scene.frameSystems);
+        std::cout << std::flush;
     }
-    else if (action == LEVEL)
+
+    // The scaling curve, one line per size.
+    std::cout << "scale, entities, load ms, tick us, frame us, memory KB\n";
+    for (const Result& result : results)
     {
-        commands.push({ Command::Type::LOAD, args });
+        std::cout << result.scale << ", " << result.numEntities
+                  << ", " << result.loadTime.asMilliseconds()
+                  << ", " << result.tickTime.asMicroseconds()
+                  << ", " << result.frameTime.asMicroseconds() << ", ";
+        printMemory(result);
+        std::cout << "\n";
     }
-    else if (action == MENU)
+    std::cout << std::flush;
+
+    CONFIG.setRepeatScale(1);
+    INPUT_INSTANCE.stop();
+    scene.clear();
+}
+
+void Game::loadLevel(const std::string& levelName)
+{
+    if (levelName == levelStart.level && levelName == CONFIG.currentLevel && scene.restoreState(levelStart))
     {
-        commands.push({ Command::Type::MENU, args });
+        scene.menuStack = levelStartMenus;
+        INPUT_INSTANCE.onLevelLoaded(levelName);
+        LOG_INFO(std::string("level restored: ") + levelName);
+        return;
     }
-    else if (action == BACK)
+
+    parseLevel(levelName);
+
+    levelStart.level = levelName;
+    scene.saveState(levelStart);
+    levelStartMenus = scene.menuStack;
+}
+
+void Game::parseLevel(const std::string& levelName)
+{
+    UI_INSTANCE.clearStaticText();
+    scene.clear();
+    CONFIG.loadLevel(levelName, scene);
+    scene.tickSystems.build();
+    scene.frameSystems.build();
+    INPUT_INSTANCE.onLevelLoaded(levelName);
+}
+
+void Game::applyQuality()
+{
+    const FrameGovernor::Knobs& knobs = governor.getKnobs();
+    scene.quality = knobs;
+    UI_INSTANCE.setRefreshInterval(knobs.uiRefreshInterval);
+    LOG_WARNING(governor.describe());
+}
+
+FrameLimiter::State Game::getFrameState() const
+{
+    if (!hasFocus) return FrameLimiter::State::UNFOCUSED;
+    if (!scene.menuStack.empty()) return FrameLimiter::State::MENU;
+    return FrameLimiter::State::GAMEPLAY;
+}
+
+void Game::executeCommands()
+{
+    commands.drain(maxCommandsPerFrame, [this](const Command& command) { executeCommand(command); });
+}
+
+void Game::executeCommand(const Command& command)
+{
+    switch (command.type)
     {
-        commands.push({ Command::Type::BACK, args });
+    case Command::Type::LOAD:
+        loadLevel(command.args.front());
+        break;
+
+    case Command::Type::BACK:
+        if (scene.menuStack.top().name != "Main menu") scene.menuStack.pop();
+        break;
+
+    case Command::Type::EXIT:
+        scene.clear();
+        isExitRequested = true;
+        close();
+        break;
+
+    case Command::Type::MENU:
+        scene.menuStack.push(scene.allMenu[command.args.front()]);
+        break;
+
+    case Command::Type::QUICK_SAVE:
+        quickSave.level = CONFIG.currentLevel;
+        scene.saveState(quickSave);
+        UI_INSTANCE.log("quick save: " + std::to_string(scene.stateStats.numBytes) + " bytes "
+                        + std::to_string(scene.stateStats.saveTime.asMicroseconds()) + " us");
+        break;
+
+    case Command::Type::QUICK_LOAD:
+        if (quickSave.level == CONFIG.currentLevel && scene.restoreState(quickSave))
+        {
+            UI_INSTANCE.log("quick load: " + std::to_string(scene.stateStats.restoreTime.asMicroseconds()) + " us");
+        }
+        break;
+
+    default:
+        break;
     }
+}
+
+void Game::post(Command::Type type, std::vector<std::string> args)
+{
+    commands.post(type, std::move(args));
 }
\ No newline at end of file
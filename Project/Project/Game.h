@@ -2,15 +2,15 @@
 
 #include "Scene.h"
 #include "Config.h"
+#include "RenderSnapshot.h"
+#include "CommandQueue.h"
+#include "FrameLimiter.h"
+#include "FrameGovernor.h"
 #include <SFML/Graphics.hpp>
 #include <vector>
 #include <stack>
-
-struct Command
-{
-    enum class Type { LOAD, EXIT, MENU, BACK } type;
-    std::vector<std::string> args;
-};
+#include <thread>
+#include <atomic>
 
 class Game
 {
@@ -26,19 +26,69 @@ public:
 
     void update(const sf::Time& elapsedTime);
 
+    void updateUi(const sf::Time& elapsedTime);
+
     void renderFrame(const sf::Time& elapsedTime);
 
+    void publishFrame();
+
     void blockingRun();
 
-    void exec(const std::string& action, const std::vector<std::string>& args);
+    void headlessRun();
+
+    // Restores the state saved at level start and reports the cost.
+    void timeRestore();
+
+    // Loads the benchmark level once per repeat scale and reports load time,
+    // memory and the cost of every system at each size.
+    void benchmarkRun();
+
+    void loadLevel(const std::string& levelName);
+
+    // Parses the level into the scene without taking the level start snapshot.
+    void parseLevel(const std::string& levelName);
+
+    void close();
+
+    void post(Command::Type type, std::vector<std::string> args = {});
 
     Scene scene;
 
-    std::queue<Command> commands;
+    CommandQueue commands;
 
     sf::RenderWindow window;
 private:
     Game();
 
+    void executeCommands();
+    void executeCommand(const Command& command);
+
+    FrameLimiter::State getFrameState() const;
+
+    void applyQuality();
+
+    void startRenderThread();
+    void stopRenderThread();
+    void renderLoop();
+
     sf::Clock clock;
+
+    FrameLimiter frameLimiter;
+    bool hasFocus = true;
+
+    FrameGovernor governor;
+
+    SnapshotBuffer snapshots;
+    std::thread renderThread;
+    std::atomic<bool> isRendering{ false };
+    std::atomic<sf::Int64> renderFrameTime{ 0 };
+    std::atomic<sf::Int64> renderWorkTime{ 0 };
+
+    // Taken right after loading, retrying the level restores it instead of reparsing.
+    SceneState levelStart;
+    std::stack<Menu> levelStartMenus;
+    SceneState quickSave;
+
+    bool isExitRequested = false;
+    int maxCommandsPerFrame = 16;
 };
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "InputSystem.h"
+#include "CommonDefinitions.h"
+#include <algorithm>
+
+static constexpr char INPUT_FILE_MAGIC[4] = { 'W', 'D', 'I', 'R' };
+static constexpr sf::Uint16 INPUT_FILE_VERSION = 1;
+
+template <typename T>
+static void writeValue(std::ofstream& file, const T& value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& file, T& value)
+{
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+InputSystem& InputSystem::getInstance()
+{
+    static InputSystem instance;
+    return instance;
+}
+
+bool InputSystem::startRecording(const std::string& path)
+{
+    stop();
+    recordFile.open(path, std::ios::binary | std::ios::trunc);
+    if (!recordFile)
+    {
+        LOG_ERROR(std::string("can't record input to: ") + path);
+        return false;
+    }
+
+    recordFile.write(INPUT_FILE_MAGIC, sizeof(INPUT_FILE_MAGIC));
+    writeValue(recordFile, INPUT_FILE_VERSION);
+    mode = Mode::RECORD;
+    return true;
+}
+
+bool InputSystem::startReplay(const std::string& path)
+{
+    stop();
+    replayFile.open(path, std::ios::binary);
+
+    char magic[sizeof(INPUT_FILE_MAGIC)] = {};
+    sf::Uint16 version = 0;
+    replayFile.read(magic, sizeof(magic));
+    readValue(replayFile, version);
+    if (!replayFile || !std::equal(std::begin(magic), std::end(magic), INPUT_FILE_MAGIC) || version != INPUT_FILE_VERSION)
+    {
+        LOG_ERROR(std::string("can't replay input from: ") + path);
+        replayFile.close();
+        return false;
+    }
+
+    mode = Mode::REPLAY;
+    keys.reset();
+    tick = 0;
+    hasNextRecord = readRecord(nextRecord);
+    return true;
+}
+
+void InputSystem::stop()
+{
+    if (mode == Mode::RECORD)
+    {
+        Record endRecord;
+        endRecord.tick = tick;
+        endRecord.type = RecordType::END;
+        writeRecord(endRecord);
+        recordFile.close();
+    }
+    else if (mode == Mode::REPLAY)
+    {
+        replayFile.close();
+        hasNextRecord = false;
+    }
+    mode = Mode::LIVE;
+}
+
+void InputSystem::handleEvent(const sf::Event& event)
+{
+    // Keys released in another window never report back, the next tick records them as up.
+    if (event.type == sf::Event::LostFocus)
+    {
+        eventKeys.reset();
+        pressedSinceTick.reset();
+        return;
+    }
+
+    if (event.type != sf::Event::KeyPressed && event.type != sf::Event::KeyReleased) return;
+
+    const int key = event.key.code;
+    if (key < 0 || key >= sf::Keyboard::KeyCount) return;
+
+    // SFML events carry no OS timestamp, the poll time is the earliest we can see.
+    if (pendingInputTime == sf::Time::Zero) pendingInputTime = clock.getElapsedTime();
+
+    const bool pressed = (event.type == sf::Event::KeyPressed);
+    eventKeys[key] = pressed;
+    if (pressed) pressedSinceTick[key] = true;
+}
+
+void InputSystem::beginTick()
+{
+    if (mode == Mode::REPLAY)
+    {
+        while (hasNextRecord && nextRecord.tick == tick &&
+              (nextRecord.type == RecordType::KEY_DOWN || nextRecord.type == RecordType::KEY_UP))
+        {
+            keys[nextRecord.key] = (nextRecord.type == RecordType::KEY_DOWN);
+            hasNextRecord = readRecord(nextRecord);
+        }
+    }
+    else
+    {
+        const std::bitset<sf::Keyboard::KeyCount> snapshot = eventKeys | pressedSinceTick;
+        pressedSinceTick.reset();
+
+        if (pendingInputTime != sf::Time::Zero)
+        {
+            if (consumedInputTime == sf::Time::Zero) consumedInputTime = pendingInputTime;
+            pendingInputTime = sf::Time::Zero;
+        }
+
+        for (int key = 0; key < sf::Keyboard::KeyCount; ++key)
+        {
+            const bool pressed = snapshot[key];
+            if (pressed != keys[key] && mode == Mode::RECORD)
+            {
+                Record keyRecord;
+                keyRecord.tick = tick;
+                keyRecord.type = pressed ? RecordType::KEY_DOWN : RecordType::KEY_UP;
+                keyRecord.key = static_cast<sf::Uint8>(key);
+                writeRecord(keyRecord);
+            }
+            keys[key] = pressed;
+        }
+    }
+
+    ++tick;
+}
+
+sf::Time InputSystem::takeConsumedInputTime()
+{
+    const sf::Time inputTime = consumedInputTime;
+    consumedInputTime = sf::Time::Zero;
+    return inputTime;
+}
+
+void InputSystem::onPresented(const sf::Time& inputTime)
+{
+    if (inputTime == sf::Time::Zero) return;
+
+    const sf::Int64 latency = (clock.getElapsedTime() - inputTime).asMicroseconds();
+    const sf::Int64 average = averageLatency;
+    lastLatency = latency;
+    averageLatency = (average == 0) ? latency : average + (latency - average) / 8;
+    if (latency > maxLatency) maxLatency = latency;
+}
+
+InputSystem::LatencyStats InputSystem::getLatencyStats() const
+{
+    LatencyStats stats;
+    stats.last = sf::microseconds(lastLatency);
+    stats.average = sf::microseconds(averageLatency);
+    stats.max = sf::microseconds(maxLatency);
+    return stats;
+}
+
+void InputSystem::onLevelLoaded(const std::string& levelName)
+{
+    if (mode == Mode::RECORD)
+    {
+        Record levelRecord;
+        levelRecord.tick = tick;
+        levelRecord.type = RecordType::LEVEL;
+        levelRecord.level = levelName;
+        writeRecord(levelRecord);
+    }
+    tick = 0;
+}
+
+bool InputSystem::pollReplayLevel(std::string& levelName)
+{
+    if (mode != Mode::REPLAY || !hasNextRecord) return false;
+    if (nextRecord.type != RecordType::LEVEL || nextRecord.tick != tick) return false;
+
+    levelName = nextRecord.level;
+    hasNextRecord = readRecord(nextRecord);
+    return true;
+}
+
+bool InputSystem::isReplayFinished() const
+{
+    if (mode != Mode::REPLAY) return false;
+    return !hasNextRecord || (nextRecord.type == RecordType::END && nextRecord.tick <= tick);
+}
+
+bool InputSystem::isKeyPressed(sf::Keyboard::Key key) const
+{
+    return key >= 0 && key < sf::Keyboard::KeyCount && keys[key];
+}
+
+void InputSystem::writeRecord(const Record& record)
+{
+    writeValue(recordFile, record.tick);
+    writeValue(recordFile, record.type);
+    if (record.type == RecordType::KEY_DOWN || record.type == RecordType::KEY_UP)
+    {
+        writeValue(recordFile, record.key);
+    }
+    else if (record.type == RecordType::LEVEL)
+    {
+        const sf::Uint16 length = static_cast<sf::Uint16>(record.level.size());
+        writeValue(recordFile, length);
+        recordFile.write(record.level.data(), length);
+    }
+}
+
+bool InputSystem::readRecord(Record& record)
+{
+    if (!readValue(replayFile, record.tick) || !readValue(replayFile, record.type)) return false;
+
+    if (record.type == RecordType::KEY_DOWN || record.type == RecordType::KEY_UP)
+    {
+        return readValue(replayFile, record.key) && record.key < sf::Keyboard::KeyCount;
+    }
+    else if (record.type == RecordType::LEVEL)
+    {
+        sf::Uint16 length = 0;
+        if (!readValue(replayFile, length)) return false;
+        record.level.resize(length);
+        return static_cast<bool>(replayFile.read(&record.level[0], length));
+    }
+    return record.type == RecordType::END;
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <SFML/Window.hpp>
+#include <atomic>
+#include <bitset>
+#include <fstream>
+#include <string>
+
+// Keyboard state as seen by the simulation. Window events are timestamped
+// as they are polled and folded into one snapshot right before each tick,
+// so the same session can be recorded to a file and replayed tick for tick.
+class InputSystem
+{
+public:
+    struct LatencyStats
+    {
+        sf::Time last;
+        sf::Time average;
+        sf::Time max;
+    };
+
+    enum class Mode
+    {
+        LIVE,
+        RECORD,
+        REPLAY
+    };
+
+    InputSystem(const InputSystem&) = delete;
+    InputSystem& operator=(const InputSystem&) = delete;
+
+    InputSystem(InputSystem&&) = delete;
+    InputSystem& operator=(InputSystem&&) = delete;
+
+    static InputSystem& getInstance();
+
+    bool startRecording(const std::string& path);
+    bool startReplay(const std::string& path);
+    void stop();
+
+    void handleEvent(const sf::Event& event);
+
+    // Called once before every simulation tick.
+    void beginTick();
+
+    // Timestamp of the oldest input the simulation consumed since the last call, zero if none.
+    sf::Time takeConsumedInputTime();
+
+    // Called right after the frame carrying that input was presented.
+    void onPresented(const sf::Time& inputTime);
+
+    LatencyStats getLatencyStats() const;
+
+    void onLevelLoaded(const std::string& levelName);
+
+    // Replay only: the level the recorded session switched to at this tick.
+    bool pollReplayLevel(std::string& levelName);
+    bool isReplayFinished() const;
+
+    bool isKeyPressed(sf::Keyboard::Key key) const;
+
+    Mode getMode() const { return mode; }
+    sf::Uint32 getTick() const { return tick; }
+
+private:
+    enum class RecordType : sf::Uint8
+    {
+        KEY_DOWN,
+        KEY_UP,
+        LEVEL,
+        END
+    };
+
+    struct Record
+    {
+        sf::Uint32 tick = 0;
+        RecordType type = RecordType::END;
+        sf::Uint8 key = 0;
+        std::string level;
+    };
+
+    InputSystem() = default;
+
+    void writeRecord(const Record& record);
+    bool readRecord(Record& record);
+
+    Mode mode = Mode::LIVE;
+    sf::Uint32 tick = 0;
+    std::bitset<sf::Keyboard::KeyCount> keys;
+
+    // Live state from window events, a press released before the tick still counts once.
+    std::bitset<sf::Keyboard::KeyCount> eventKeys;
+    std::bitset<sf::Keyboard::KeyCount> pressedSinceTick;
+    sf::Time pendingInputTime;
+    sf::Time consumedInputTime;
+
+    sf::Clock clock;
+    std::atomic<sf::Int64> lastLatency{ 0 };
+    std::atomic<sf::Int64> averageLatency{ 0 };
+    std::atomic<sf::Int64> maxLatency{ 0 };
+
+    std::ofstream recordFile;
+    std::ifstream replayFile;
+    Record nextRecord;
+    bool hasNextRecord = false;
+};
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "JobSystem.h"
+
+static thread_local int currentWorker = -1;
+
+int JobSystem::getCurrentWorker()
+{
+    return currentWorker;
+}
+
+JobSystem& JobSystem::getInstance()
+{
+    static JobSystem instance;
+    return instance;
+}
+
+JobSystem::~JobSystem()
+{
+    stop();
+}
+
+void JobSystem::start(int numWorkers)
+{
+    stop();
+
+    if (numWorkers < 0)
+    {
+        const int numHardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+        numWorkers = std::max(numHardwareThreads - 1, 0);
+    }
+
+    isRunning = true;
+    for (int idx = 0; idx < numWorkers; ++idx)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int idx = 0; idx < numWorkers; ++idx)
+    {
+        workers[idx]->thread = std::thread(&JobSystem::workerLoop, this, idx);
+    }
+    statsClock.restart();
+}
+
+void JobSystem::stop()
+{
+    if (!isRunning) return;
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isRunning = false;
+    }
+    wakeUp.notify_all();
+
+    for (auto& worker : workers)
+    {
+        worker->thread.join();
+    }
+    workers.clear();
+}
+
+void JobSystem::submit(Job job, Group& group)
+{
+    ++group.pending;
+
+    if (workers.empty())
+    {
+        job();
+        --group.pending;
+        return;
+    }
+
+    // Workers push to their own deque, other threads spread jobs round robin.
+    const int workerIndex = (currentWorker >= 0) ? currentWorker : static_cast<int>(nextWorker++ % workers.size());
+    Worker& worker = *workers[workerIndex];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back({ std::move(job), &group });
+    }
+
+    ++numQueued;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeUp.notify_one();
+}
+
+void JobSystem::wait(Group& group)
+{
+    while (group.pending > 0)
+    {
+        if (!tryRunJob(currentWorker))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+std::vector<JobSystem::WorkerStats> JobSystem::collectStats()
+{
+    const float elapsedMicroseconds = static_cast<float>(statsClock.restart().asMicroseconds());
+
+    std::vector<WorkerStats> stats(workers.size());
+    for (std::size_t idx = 0; idx < workers.size(); ++idx)
+    {
+        Worker& worker = *workers[idx];
+        stats[idx].numJobs = worker.numJobs.exchange(0);
+        stats[idx].numStolen = worker.numStolen.exchange(0);
+        const sf::Int64 busyMicroseconds = worker.busyMicroseconds.exchange(0);
+        stats[idx].utilization = (elapsedMicroseconds > 0.0f) ? busyMicroseconds / elapsedMicroseconds : 0.0f;
+    }
+    return stats;
+}
+
+void JobSystem::workerLoop(int workerIndex)
+{
+    currentWorker = workerIndex;
+
+    while (isRunning)
+    {
+        if (tryRunJob(workerIndex)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this]() { return numQueued > 0 || !isRunning; });
+    }
+
+    currentWorker = -1;
+}
+
+bool JobSystem::tryRunJob(int workerIndex)
+{
+    QueuedJob queuedJob;
+    const bool hasJob = (workerIndex >= 0 && popJob(workerIndex, queuedJob)) || stealJob(workerIndex, queuedJob);
+    if (!hasJob) return false;
+
+    --numQueued;
+
+    sf::Clock jobClock;
+    queuedJob.job();
+    --queuedJob.group->pending;
+
+    if (workerIndex >= 0)
+    {
+        Worker& worker = *workers[workerIndex];
+        ++worker.numJobs;
+        worker.busyMicroseconds += jobClock.getElapsedTime().asMicroseconds();
+    }
+    return true;
+}
+
+bool JobSystem::popJob(int workerIndex, QueuedJob& queuedJob)
+{
+    Worker& worker = *workers[workerIndex];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.jobs.empty()) return false;
+
+    queuedJob = std::move(worker.jobs.back());
+    worker.jobs.pop_back();
+    return true;
+}
+
+bool JobSystem::stealJob(int thiefIndex, QueuedJob& queuedJob)
+{
+    const int numWorkers = static_cast<int>(workers.size());
+    const int firstVictim = (thiefIndex >= 0) ? thiefIndex + 1 : 0;
+    for (int offset = 0; offset < numWorkers; ++offset)
+    {
+        const int victimIndex = (firstVictim + offset) % numWorkers;
+        if (victimIndex == thiefIndex) continue;
+
+        Worker& victim = *workers[victimIndex];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.jobs.empty()) continue;
+
+        queuedJob = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        if (thiefIndex >= 0) ++workers[thiefIndex]->numStolen;
+        return true;
+    }
+    return false;
+}
+
+TaskGraph::TaskId TaskGraph::addTask(std::function<void()> task)
+{
+    Task newTask;
+    newTask.function = std::move(task);
+    tasks.push_back(std::move(newTask));
+    return tasks.size() - 1;
+}
+
+void TaskGraph::addDependency(TaskId before, TaskId after)
+{
+    tasks[before].successors.push_back(after);
+    ++tasks[after].numDependencies;
+}
+
+void TaskGraph::run(JobSystem& jobSystem)
+{
+    remaining = std::make_unique<std::atomic<int>[]>(tasks.size());
+    for (TaskId taskId = 0; taskId < tasks.size(); ++taskId)
+    {
+        remaining[taskId] = tasks[taskId].numDependencies;
+    }
+
+    JobSystem::Group group;
+    for (TaskId taskId = 0; taskId < tasks.size(); ++taskId)
+    {
+        if (tasks[taskId].numDependencies == 0)
+        {
+            schedule(jobSystem, taskId, group);
+        }
+    }
+    jobSystem.wait(group);
+}
+
+void TaskGraph::clear()
+{
+    tasks.clear();
+    remaining.reset();
+}
+
+void TaskGraph::schedule(JobSystem& jobSystem, TaskId taskId, JobSystem::Group& group)
+{
+    jobSystem.submit([this, &jobSystem, taskId, &group]()
+    {
+        tasks[taskId].function();
+        for (TaskId successor : tasks[taskId].successors)
+        {
+            if (--remaining[successor] == 0)
+            {
+                schedule(jobSystem, successor, group);
+            }
+        }
+    }, group);
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <SFML/System.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Thread pool with one job deque per worker. Owners take their newest job,
+// idle workers steal the oldest job of another worker. Threads waiting on
+// a group help run jobs instead of blocking.
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    struct Group
+    {
+        std::atomic<int> pending{ 0 };
+    };
+
+    struct WorkerStats
+    {
+        sf::Uint64 numJobs = 0;
+        sf::Uint64 numStolen = 0;
+        float utilization = 0.0f;
+    };
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    JobSystem(JobSystem&&) = delete;
+    JobSystem& operator=(JobSystem&&) = delete;
+
+    static JobSystem& getInstance();
+
+    // Negative count picks one worker per spare hardware thread, zero runs everything inline.
+    void start(int numWorkers);
+    void stop();
+
+    int getNumWorkers() const { return static_cast<int>(workers.size()); }
+
+    // Index of the worker running the calling thread, -1 outside the pool.
+    static int getCurrentWorker();
+
+    void submit(Job job, Group& group);
+    void wait(Group& group);
+
+    // Calls func(begin, end) over [0, count) in chunks of grainSize.
+    template <typename Func>
+    void parallelFor(std::size_t count, std::size_t grainSize, Func&& func);
+
+    // Per worker counters since the previous call.
+    std::vector<WorkerStats> collectStats();
+
+private:
+    struct QueuedJob
+    {
+        Job job;
+        Group* group = nullptr;
+    };
+
+    struct Worker
+    {
+        std::deque<QueuedJob> jobs;
+        std::mutex mutex;
+        std::thread thread;
+
+        std::atomic<sf::Uint64> numJobs{ 0 };
+        std::atomic<sf::Uint64> numStolen{ 0 };
+        std::atomic<sf::Int64> busyMicroseconds{ 0 };
+    };
+
+    JobSystem() = default;
+    ~JobSystem();
+
+    void workerLoop(int workerIndex);
+    bool tryRunJob(int workerIndex);
+    bool popJob(int workerIndex, QueuedJob& queuedJob);
+    bool stealJob(int thiefIndex, QueuedJob& queuedJob);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> isRunning{ false };
+    std::atomic<int> numQueued{ 0 };
+    std::atomic<unsigned> nextWorker{ 0 };
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+
+    sf::Clock statsClock;
+};
+
+template <typename Func>
+void JobSystem::parallelFor(std::size_t count, std::size_t grainSize, Func&& func)
+{
+    if (count == 0) return;
+
+    grainSize = std::max<std::size_t>(grainSize, 1);
+    if (workers.empty() || count <= grainSize)
+    {
+        func(std::size_t(0), count);
+        return;
+    }
+
+    Group group;
+    for (std::size_t begin = grainSize; begin < count; begin += grainSize)
+    {
+        const std::size_t end = std::min(begin + grainSize, count);
+        submit([&func, begin, end]() { func(begin, end); }, group);
+    }
+
+    func(std::size_t(0), grainSize);
+    wait(group);
+}
+
+// Runs tasks on the job system as soon as all of their dependencies finished.
+class TaskGraph
+{
+public:
+    using TaskId = std::size_t;
+
+    TaskId addTask(std::function<void()> task);
+    void addDependency(TaskId before, TaskId after);
+
+    void run(JobSystem& jobSystem);
+    void clear();
+
+    std::size_t size() const { return tasks.size(); }
+
+private:
+    struct Task
+    {
+        std::function<void()> function;
+        std::vector<TaskId> successors;
+        int numDependencies = 0;
+    };
+
+    void schedule(JobSystem& jobSystem, TaskId taskId, JobSystem::Group& group);
+
+    std::vector<Task> tasks;
+    std::unique_ptr<std::atomic<int>[]> remaining;
+};
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "LevelStreaming.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+static constexpr std::uint32_t NO_REGION = std::numeric_limits<std::uint32_t>::max();
+
+void LevelStreaming::configure(const Settings& newSettings)
+{
+    clear();
+    settings = newSettings;
+    settings.activeRadius = std::max(settings.activeRadius, 0);
+    settings.keepRadius = std::max(settings.keepRadius, settings.activeRadius);
+    settings.maxTransitionsPerTick = std::max(settings.maxTransitionsPerTick, 1);
+}
+
+int LevelStreaming::toCell(float coordinate) const
+{
+    static constexpr float MAX_CELL = 1 << 30;
+    return static_cast<int>(std::max(-MAX_CELL, std::min(MAX_CELL, std::floor(coordinate / settings.regionSize))));
+}
+
+std::uint32_t LevelStreaming::getRegion(int x, int y)
+{
+    const sf::Uint64 key = (static_cast<sf::Uint64>(static_cast<sf::Uint32>(x)) << 32) | static_cast<sf::Uint32>(y);
+    auto findIt = regionIndex.find(key);
+    if (findIt != regionIndex.end()) return findIt->second;
+
+    const std::uint32_t regionIdx = static_cast<std::uint32_t>(regions.size());
+    regions.emplace_back();
+    regions.back().x = x;
+    regions.back().y = y;
+    regionIndex.emplace(key, regionIdx);
+    return regionIdx;
+}
+
+std::uint32_t LevelStreaming::findRegion(EntityHandle handle) const
+{
+    if (handle.index >= entityRegions.size() || entityRegions[handle.index].handle != handle) return NO_REGION;
+    return entityRegions[handle.index].region;
+}
+
+void LevelStreaming::assign(EntityHandle handle, std::uint32_t regionIdx)
+{
+    if (entityRegions.size() <= handle.index) entityRegions.resize(handle.index + 1);
+    const std::uint32_t previousIdx = findRegion(handle);
+    if (previousIdx == regionIdx) return;
+
+    if (previousIdx != NO_REGION)
+    {
+        std::vector<EntityHandle>& previousEntities = regions[previousIdx].entities;
+        auto findIt = std::find(previousEntities.begin(), previousEntities.end(), handle);
+        if (findIt != previousEntities.end()) previousEntities.erase(findIt);
+    }
+    regions[regionIdx].entities.push_back(handle);
+    entityRegions[handle.index] = { handle, regionIdx };
+}
+
+bool LevelStreaming::add(EntityHandle handle, const sf::FloatRect& bounds)
+{
+    if (!isEnabled()) return false;
+    if (bounds.width > settings.regionSize || bounds.height > settings.regionSize) return false;
+
+    // New regions start live, the next update settles every region.
+    const std::size_t numRegions = regions.size();
+    assign(handle, getRegion(toCell(bounds.left + bounds.width / 2.0f), toCell(bounds.top + bounds.height / 2.0f)));
+    if (regions.size() != numRegions) isSettled = false;
+    return true;
+}
+
+bool LevelStreaming::addChild(EntityHandle handle, EntityHandle parent)
+{
+    const std::uint32_t regionIdx = findRegion(parent);
+    if (!isEnabled() || regionIdx == NO_REGION) return false;
+
+    assign(handle, regionIdx);
+    return true;
+}
+
+bool LevelStreaming::move(EntityHandle handle, const sf::Vector2f& position)
+{
+    if (!isEnabled() || findRegion(handle) == NO_REGION) return false;
+
+    // A region first reached this way starts live, updates park it once it is out of range.
+    const std::uint32_t regionIdx = getRegion(toCell(position.x), toCell(position.y));
+    if (regionIdx == findRegion(handle)) return false;
+    assign(handle, regionIdx);
+    return true;
+}
+
+bool LevelStreaming::isLive(EntityHandle handle) const
+{
+    const std::uint32_t regionIdx = findRegion(handle);
+    return (regionIdx == NO_REGION) || regions[regionIdx].isActive;
+}
+
+void LevelStreaming::update(const sf::Vector2f& center, std::vector<Transition>& transitions)
+{
+    transitions.clear();
+    stats.numActivated = 0;
+    stats.numDeactivated = 0;
+    if (!isEnabled()) return;
+
+    const int centerX = toCell(center.x);
+    const int centerY = toCell(center.y);
+
+    pending.clear();
+    for (std::uint32_t regionIdx = 0; regionIdx < regions.size(); ++regionIdx)
+    {
+        const Region& region = regions[regionIdx];
+        const int distance = std::max(std::abs(region.x - centerX), std::abs(region.y - centerY));
+        const bool shouldBeActive = distance <= (region.isActive ? settings.keepRadius : settings.activeRadius);
+        if (shouldBeActive != region.isActive || !isSettled)
+        {
+            pending.push_back({ distance, { regionIdx, shouldBeActive } });
+        }
+    }
+
+    // Nearest regions first, they are the ones about to be seen.
+    std::sort(pending.begin(), pending.end(), [](const auto& left, const auto& right) { return left.first < right.first; });
+    const std::size_t numTransitions = isSettled ? std::min<std::size_t>(pending.size(), settings.maxTransitionsPerTick) : pending.size();
+    for (std::size_t idx = 0; idx < numTransitions; ++idx)
+    {
+        const Transition& transition = pending[idx].second;
+        regions[transition.region].isActive = transition.isActive;
+        transitions.push_back(transition);
+        ++(transition.isActive ? stats.numActivated : stats.numDeactivated);
+    }
+    isSettled = true;
+
+    stats.numRegions = regions.size();
+    stats.numActive = std::count_if(regions.begin(), regions.end(), [](const Region& region) { return region.isActive; });
+    stats.numPending = pending.size() - numTransitions;
+}
+
+void LevelStreaming::clear()
+{
+    regions.clear();
+    regionIndex.clear();
+    entityRegions.clear();
+    pending.clear();
+    isSettled = false;
+    stats = Stats();
+}
\ No newline at end of file
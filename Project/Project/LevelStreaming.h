@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Entity.h"
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/System.hpp>
+#include <unordered_map>
+#include <vector>
+
+// Splits the level into square regions and decides which of them are live
+// around a point. Regions switch on within activeRadius and off beyond
+// keepRadius, the gap keeps a region at the edge from flickering. The scene
+// parks the entities of inactive regions, see Scene::setEntityActive.
+class LevelStreaming
+{
+public:
+    struct Settings
+    {
+        // Zero disables streaming, every entity stays active.
+        float regionSize = 0.0f;
+        int activeRadius = 1;
+        int keepRadius = 2;
+        int maxTransitionsPerTick = 4;
+    };
+
+    struct Stats
+    {
+        std::size_t numRegions = 0;
+        std::size_t numActive = 0;
+        std::size_t numActivated = 0;
+        std::size_t numDeactivated = 0;
+        std::size_t numPending = 0;
+    };
+
+    struct Transition
+    {
+        std::uint32_t region = 0;
+        bool isActive = false;
+    };
+
+    void configure(const Settings& newSettings);
+    bool isEnabled() const { return settings.regionSize > 0.0f; }
+    const Settings& getSettings() const { return settings; }
+
+    // An entity whose bounds do not fit in a region is not streamed.
+    bool add(EntityHandle handle, const sf::FloatRect& bounds);
+
+    // Children live and park together with their parent. Also moves an
+    // already streamed child to its parent's current region.
+    bool addChild(EntityHandle handle, EntityHandle parent);
+
+    // Moves a streamed entity to the region under position, false when it is
+    // not streamed or stays where it was. Children are not moved.
+    bool move(EntityHandle handle, const sf::Vector2f& position);
+
+    // Whether the entity's region is live, true for entities not streamed.
+    bool isLive(EntityHandle handle) const;
+
+    // Fills transitions with the regions to switch this tick, nearest first.
+    // Transitions beyond the per tick budget wait for later ticks, except
+    // right after configure or invalidate when every region is settled at once.
+    void update(const sf::Vector2f& center, std::vector<Transition>& transitions);
+
+    // Entities of a region, stale handles may remain and can be pruned by the caller.
+    std::vector<EntityHandle>& getEntities(std::uint32_t region) { return regions[region].entities; }
+
+    // Forgets which regions are live, the next update settles all of them.
+    void invalidate() { isSettled = false; }
+
+    const Stats& getStats() const { return stats; }
+
+    void clear();
+
+private:
+    struct Region
+    {
+        int x = 0;
+        int y = 0;
+        bool isActive = true;
+        std::vector<EntityHandle> entities;
+    };
+
+    std::uint32_t getRegion(int x, int y);
+
+    // Lists the entity in the region, taking it out of its previous one.
+    void assign(EntityHandle handle, std::uint32_t regionIdx);
+    int toCell(float coordinate) const;
+
+    Settings settings;
+    bool isSettled = false;
+
+    std::vector<Region> regions;
+    std::unordered_map<sf::Uint64, std::uint32_t> regionIndex;
+
+    // Region of each streamed entity by slot index, the handle tells a reused slot apart.
+    struct EntityRegion
+    {
+        EntityHandle handle = INVALID_ENTITY;
+        std::uint32_t region = 0;
+    };
+    std::vector<EntityRegion> entityRegions;
+
+    // NO_REGION when the entity is not streamed.
+    std::uint32_t findRegion(EntityHandle handle) const;
+
+    std::vector<std::pair<int, Transition>> pending;
+    Stats stats;
+};
\ No newline at end of file
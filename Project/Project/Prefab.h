@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Entity.h"
+#include <SFML/System.hpp>
+#include <string>
+#include <vector>
+#include <limits>
+
+using PrefabId = std::uint32_t;
+static constexpr PrefabId INVALID_PREFAB = std::numeric_limits<PrefabId>::max();
+
+// Entity template parsed once per level. Despawned instances go back to the
+// pool with their components and a disabled body, so spawning them again
+// neither allocates nor touches the b2World body list.
+struct Prefab
+{
+    struct Stats
+    {
+        std::size_t numSpawned = 0;
+        std::size_t numReused = 0;
+        std::size_t numAllocated = 0;
+    };
+
+    std::string name;
+    Signature signature = 0;
+
+    // The body component points at a disabled template body that is cloned.
+    EntityDesc desc;
+
+    // Entries below numFree are ready to spawn, the rest keep their capacity.
+    std::vector<EntityDesc> pool;
+    std::size_t numFree = 0;
+
+    Stats stats;
+};
+
+// World pixels and degrees, velocity in pixels per second applies to bodies only.
+struct SpawnDesc
+{
+    sf::Vector2f position;
+    float rotation = 0.0f;
+    sf::Vector2f velocity;
+};
\ No newline at end of file
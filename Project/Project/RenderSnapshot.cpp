@@ -0,0 +1,91 @@
+#include "RenderSnapshot.h"
+#include <chrono>
+
+SceneSnapshot::Item& SceneSnapshot::nextItem()
+{
+    if (numItems == items.size())
+    {
+        items.emplace_back();
+    }
+    return items[numItems++];
+}
+
+void SceneSnapshot::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    sf::View prevView = target.getView();
+    target.setView(view);
+
+    states.transform *= transform;
+    for (std::size_t idx = 0; idx < numItems; ++idx)
+    {
+        const Item& item = items[idx];
+        sf::RenderStates renderState = states;
+        renderState.transform *= item.transform;
+        std::visit([&target, &renderState](const auto& drawable) { target.draw(drawable, renderState); }, item.drawable);
+    }
+
+    target.setView(prevView);
+}
+
+sf::Text& UiSnapshot::nextText()
+{
+    if (numTexts == texts.size())
+    {
+        texts.emplace_back();
+    }
+    return texts[numTexts++];
+}
+
+void UiSnapshot::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    for (std::size_t idx = 0; idx < numTexts; ++idx)
+    {
+        target.draw(texts[idx], states);
+    }
+}
+
+void SnapshotBuffer::publish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // A snapshot replaced before it was drawn hands its input over to the newer one.
+        const RenderSnapshot& skipped = buffers[readyIndex];
+        RenderSnapshot& published = buffers[writeIndex];
+        if (hasNewSnapshot && skipped.inputTime != sf::Time::Zero &&
+           (published.inputTime == sf::Time::Zero || skipped.inputTime < published.inputTime))
+        {
+            published.inputTime = skipped.inputTime;
+        }
+
+        std::swap(writeIndex, readyIndex);
+        hasNewSnapshot = true;
+    }
+    snapshotReady.notify_one();
+}
+
+const RenderSnapshot* SnapshotBuffer::acquire(const sf::Time& timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    const auto waitTime = std::chrono::microseconds(timeout.asMicroseconds());
+    if (!snapshotReady.wait_for(lock, waitTime, [this] { return hasNewSnapshot; }))
+    {
+        return nullptr;
+    }
+
+    std::swap(readIndex, readyIndex);
+    hasNewSnapshot = false;
+    return &buffers[readIndex];
+}
+
+void SnapshotBuffer::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    hasNewSnapshot = false;
+    for (auto& buffer : buffers)
+    {
+        buffer.scene.clear();
+        buffer.ui.clear();
+        buffer.inputTime = sf::Time::Zero;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <vector>
+#include <variant>
+#include <mutex>
+#include <condition_variable>
+
+struct SceneSnapshot : public sf::Drawable
+{
+    struct Item
+    {
+        sf::Transform transform;
+        std::variant<sf::RectangleShape, sf::Sprite> drawable;
+    };
+
+    // Slots are reused between ticks so copying drawables does not reallocate.
+    Item& nextItem();
+
+    void clear() { numItems = 0; }
+
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+    std::vector<Item> items;
+    std::size_t numItems = 0;
+
+    sf::View view;
+    sf::Transform transform;
+};
+
+struct UiSnapshot : public sf::Drawable
+{
+    sf::Text& nextText();
+
+    void clear() { numTexts = 0; }
+
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+    std::vector<sf::Text> texts;
+    std::size_t numTexts = 0;
+};
+
+struct RenderSnapshot
+{
+    SceneSnapshot scene;
+    UiSnapshot ui;
+
+    // Oldest input this snapshot reflects, zero if none.
+    sf::Time inputTime;
+};
+
+// Hands snapshots from the simulation thread to the render thread.
+// The simulation always owns the back buffer and the renderer the front one,
+// a third slot holds the latest published snapshot so neither side blocks.
+class SnapshotBuffer
+{
+public:
+    RenderSnapshot& back() { return buffers[writeIndex]; }
+
+    void publish();
+
+    const RenderSnapshot* acquire(const sf::Time& timeout);
+
+    void reset();
+
+private:
+    std::array<RenderSnapshot, 3> buffers;
+    int writeIndex = 0;
+    int readyIndex = 1;
+    int readIndex = 2;
+    bool hasNewSnapshot = false;
+
+    std::mutex mutex;
+    std::condition_variable snapshotReady;
+};
\ No newline at end of file
@@ -4,29 +4,297 @@
 #include <algorithm>
 #include <chrono>
 #include <random>
+#include <cassert>
 
-Entity* Scene::getEntity(const std::string& entityName)
+// Rows per job when a system splits an archetype with parallelFor.
+static constexpr std::size_t SYSTEM_GRAIN_SIZE = 512;
+
+static constexpr std::uint32_t NOT_MOVING = ~std::uint32_t(0);
+static constexpr sf::Uint64 NO_ROW = ~sf::Uint64(0);
+
+Scene::Scene()
 {
-    auto findIt = std::find_if(sceneGraph.begin(),
-                               sceneGraph.end(),
-                               [entityName](auto& entity) {return entity.name == entityName; });
-    return (findIt != sceneGraph.end()) ? findIt._Ptr : nullptr;
+    bodyQuery = entities.addQuery(signatureOf(Component::Type::BODY));
+    animationQuery = entities.addQuery(signatureOf(Component::Type::ANIMATION));
+    controllerQuery = entities.addQuery(signatureOf(Component::Type::CONTROLLER));
+    cameraQuery = entities.addQuery(signatureOf(Component::Type::CAMERA));
+
+    world.SetContactListener(&contacts);
+
+    using Type = Component::Type;
+
+    tickSystems.add("physics", NO_QUERY, 0, PHYSICS_WORLD,
+                    [this](const sf::Time& elapsedTime) { stepPhysics(elapsedTime); });
+    tickSystems.add("contacts", NO_QUERY, PHYSICS_WORLD | signatureOf(Type::BODY), AUDIO,
+                    [this](const sf::Time&) { dispatchContacts(); });
+    // Also picks up the bodies woken by the step, see wakeBody.
+    tickSystems.add("body sync", bodyQuery, PHYSICS_WORLD, PHYSICS_WORLD | signatureOf(Type::BODY),
+                    [this](const sf::Time&) { updateBodies(); });
+    tickSystems.add("animation", animationQuery, signatureOf(Type::BODY), signatureOf(Type::ANIMATION),
+                    [this](const sf::Time& elapsedTime) { updateAnimations(elapsedTime); });
+    tickSystems.add("controller", controllerQuery, signatureOf(Type::BODY, Type::CONTROLLER), PHYSICS_WORLD | AUDIO,
+                    [this](const sf::Time&) { updateControllers(); });
+
+    frameSystems.add("interpolation", bodyQuery, signatureOf(Type::BODY), ENTITY_TRANSFORMS,
+                     [this](const sf::Time&) { interpolateBodies(); });
+    frameSystems.add("transforms", NO_QUERY, 0, ENTITY_TRANSFORMS,
+                     [this](const sf::Time&) { updateTransforms(); });
+    frameSystems.add("camera", cameraQuery, signatureOf(Type::CAMERA) | ENTITY_TRANSFORMS, SCENE_VIEW,
+                     [this](const sf::Time&) { updateCamera(); });
+    frameSystems.add("draw grid", NO_QUERY, signatureOf(Type::SHAPE, Type::SPRITE, Type::ANIMATION) | ENTITY_TRANSFORMS, DRAW_GRID,
+                     [this](const sf::Time&) { updateDrawGrid(); });
 }
 
-void Scene::update(const sf::Time& elapsedTime)
+EntityHandle Scene::getEntity(const std::string& entityName) const
 {
-    view = GAME_INSTANCE.window.getDefaultView();
+    return entities.find(entityName);
+}
+
+static sf::FloatRect unite(const sf::FloatRect& left, const sf::FloatRect& right)
+{
+    const float minX = std::min(left.left, right.left);
+    const float minY = std::min(left.top, right.top);
+    const float maxX = std::max(left.left + left.width, right.left + right.width);
+    const float maxY = std::max(left.top + left.height, right.top + right.height);
+    return { minX, minY, maxX - minX, maxY - minY };
+}
+
+static bool isDrawable(const Archetype& archetype)
+{
+    return (archetype.signature & signatureOf(Component::Type::SHAPE, Component::Type::SPRITE, Component::Type::ANIMATION)) != 0;
+}
+
+EntityHandle Scene::createEntity(EntityDesc desc)
+{
+    assert(!isRunningSystems && "use Scene::commands while systems run");
+    return registerEntity(entities.create(std::move(desc)));
+}
+
+EntityHandle Scene::registerEntity(EntityHandle handle)
+{
+    // Broadphase hits map back to entities through the slot index.
+    Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+    if (pBody != nullptr)
+    {
+        pBody->pBody->SetUserData(reinterpret_cast<void*>(static_cast<std::uintptr_t>(handle.index)));
+        wakeBody(handle);
+    }
+
+    std::uint32_t archetypeIdx, row;
+    if (entities.getLocation(handle, archetypeIdx, row))
+    {
+        const Archetype& archetype = entities.getArchetypes()[archetypeIdx];
+        if (isDrawable(archetype)) drawGrid.update(handle, computeBounds(archetype, row));
+    }
+    return handle;
+}
 
-    const int32 velocityIterations = 50;
-    const int32 positionIterations = 50;
-    world.Step(elapsedTime.asSeconds(), velocityIterations, positionIterations);
+void Scene::wakeBody(EntityHandle handle)
+{
+    const Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+    if (pBody == nullptr) return;
+    const b2Body& body = *pBody->pBody;
+    if (body.GetType() == b2_staticBody || !body.IsEnabled() || !body.IsAwake()) return;
 
-    for (auto& entity : sceneGraph)
+    if (movingSlots.size() <= handle.index) movingSlots.resize(handle.index + 1, NOT_MOVING);
+    std::uint32_t& position = movingSlots[handle.index];
+    if (position == NOT_MOVING)
+    {
+        position = static_cast<std::uint32_t>(movingBodies.size());
+        movingBodies.push_back(handle);
+    }
+    else
     {
-        entity.update(elapsedTime);
+        // The slot may still be listed under an entity destroyed this tick.
+        movingBodies[position] = handle;
     }
+}
+
+void Scene::destroyEntity(EntityHandle handle)
+{
+    assert(!isRunningSystems && "use Scene::commands while systems run");
+    if (!entities.isAlive(handle)) return;
 
-    if (!AudioSystem::getInstance().isMusicPlaying() && playlist.size() > 0)
+    drawGrid.remove(handle);
+
+    Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+    const PrefabId prefabId = (handle.index < instancePrefabs.size()) ? instancePrefabs[handle.index] : INVALID_PREFAB;
+    if (prefabId == INVALID_PREFAB)
+    {
+        if (pBody != nullptr) world.DestroyBody(pBody->pBody);
+        entities.destroy(handle);
+        return;
+    }
+
+    if (pBody != nullptr) pBody->pBody->SetEnabled(false);
+    instancePrefabs[handle.index] = INVALID_PREFAB;
+
+    Prefab& prefab = prefabs[prefabId];
+    if (prefab.numFree == prefab.pool.size()) prefab.pool.emplace_back();
+    entities.destroy(handle, prefab.pool[prefab.numFree].components);
+    ++prefab.numFree;
+}
+
+static b2Body* cloneBody(b2World& world, const b2Body& source)
+{
+    b2BodyDef bodyDef;
+    bodyDef.type = source.GetType();
+    bodyDef.position = source.GetPosition();
+    bodyDef.angle = source.GetAngle();
+    bodyDef.linearDamping = source.GetLinearDamping();
+    bodyDef.angularDamping = source.GetAngularDamping();
+    bodyDef.fixedRotation = source.IsFixedRotation();
+    bodyDef.bullet = source.IsBullet();
+    bodyDef.gravityScale = source.GetGravityScale();
+    bodyDef.enabled = false;
+    b2Body* body = world.CreateBody(&bodyDef);
+
+    for (const b2Fixture* pFixture = source.GetFixtureList(); pFixture != nullptr; pFixture = pFixture->GetNext())
+    {
+        b2FixtureDef fixture;
+        fixture.shape = pFixture->GetShape();
+        fixture.density = pFixture->GetDensity();
+        fixture.friction = pFixture->GetFriction();
+        fixture.restitution = pFixture->GetRestitution();
+        fixture.isSensor = pFixture->IsSensor();
+        fixture.filter = pFixture->GetFilterData();
+        body->CreateFixture(&fixture);
+    }
+    return body;
+}
+
+PrefabId Scene::addPrefab(const std::string& name, EntityDesc desc, std::size_t poolSize)
+{
+    if (prefabIndex.count(name) != 0)
+    {
+        LOG_ERROR(std::string("duplicate prefab: ") + name);
+        return INVALID_PREFAB;
+    }
+
+    Prefab prefab;
+    prefab.name = name;
+    for (const Component& component : desc.components)
+    {
+        prefab.signature |= signatureOf(component.getType());
+        if (component.getType() == Component::Type::BODY) std::get<Body>(component.var).pBody->SetEnabled(false);
+    }
+    prefab.desc = std::move(desc);
+    prefab.desc.name.clear();
+    growPool(prefab, poolSize);
+
+    const PrefabId prefabId = static_cast<PrefabId>(prefabs.size());
+    prefabs.push_back(std::move(prefab));
+    prefabIndex.emplace(name, prefabId);
+    return prefabId;
+}
+
+PrefabId Scene::getPrefab(const std::string& name) const
+{
+    auto findIt = prefabIndex.find(name);
+    return (findIt != prefabIndex.end()) ? findIt->second : INVALID_PREFAB;
+}
+
+void Scene::growPool(Prefab& prefab, std::size_t count)
+{
+    prefab.pool.reserve(prefab.numFree + count);
+    for (std::size_t idx = 0; idx < count; ++idx)
+    {
+        if (prefab.numFree == prefab.pool.size()) prefab.pool.emplace_back();
+        EntityDesc& desc = prefab.pool[prefab.numFree++];
+        desc.components = prefab.desc.components;
+        for (Component& component : desc.components)
+        {
+            if (component.getType() != Component::Type::BODY) continue;
+            Body& body = std::get<Body>(component.var);
+            body.pBody = cloneBody(world, *body.pBody);
+        }
+    }
+    prefab.stats.numAllocated += count;
+}
+
+EntityHandle Scene::instantiate(PrefabId prefabId, const SpawnDesc& spawn)
+{
+    assert(!isRunningSystems && "use Scene::commands while systems run");
+    if (prefabId >= prefabs.size()) return INVALID_ENTITY;
+
+    Prefab& prefab = prefabs[prefabId];
+    if (prefab.numFree == 0)
+    {
+        growPool(prefab, 1);
+    }
+    else
+    {
+        ++prefab.stats.numReused;
+    }
+
+    EntityDesc& desc = prefab.pool[--prefab.numFree];
+    desc.position = spawn.position;
+    desc.rotation = spawn.rotation;
+    desc.parent = INVALID_ENTITY;
+    for (Component& component : desc.components)
+    {
+        const Component::Type type = component.getType();
+        if (type == Component::Type::BODY)
+        {
+            Body& body = std::get<Body>(component.var);
+            const b2Vec2 position(spawn.position.x / SCALE_FACTOR, spawn.position.y / SCALE_FACTOR);
+            const float angle = degreeToRadian(spawn.rotation);
+            body.pBody->SetTransform(position, angle);
+            body.pBody->SetLinearVelocity({ spawn.velocity.x / SCALE_FACTOR, spawn.velocity.y / SCALE_FACTOR });
+            body.pBody->SetAngularVelocity(0.0f);
+            body.pBody->SetEnabled(true);
+            body.pBody->SetAwake(true);
+            body.velocity = body.pBody->GetLinearVelocity();
+            body.currentState = { position, angle };
+            body.previousState = body.currentState;
+        }
+        else if (type != Component::Type::CONTROLLER)
+        {
+            // Restart animations and the like, controllers keep no state.
+            for (const Component& source : prefab.desc.components)
+            {
+                if (source.getType() == type) component.var = source.var;
+            }
+        }
+    }
+
+    const EntityHandle handle = registerEntity(entities.createFrom(desc));
+    if (instancePrefabs.size() <= handle.index) instancePrefabs.resize(handle.index + 1, INVALID_PREFAB);
+    instancePrefabs[handle.index] = prefabId;
+    ++prefab.stats.numSpawned;
+    return handle;
+}
+
+void Scene::instantiate(PrefabId prefabId, const std::vector<SpawnDesc>& spawns, std::vector<EntityHandle>& result)
+{
+    assert(!isRunningSystems && "use Scene::commands while systems run");
+    if (prefabId >= prefabs.size()) return;
+
+    Prefab& prefab = prefabs[prefabId];
+    if (prefab.numFree < spawns.size()) growPool(prefab, spawns.size() - prefab.numFree);
+    entities.reserve(prefab.signature, spawns.size());
+    result.reserve(result.size() + spawns.size());
+
+    for (const SpawnDesc& spawn : spawns)
+    {
+        result.push_back(instantiate(prefabId, spawn));
+    }
+}
+
+void Scene::update(const sf::Time& elapsedTime)
+{
+    view = GAME_INSTANCE.window.getDefaultView();
+
+    commands.setNumWorkers(JOBS.getNumWorkers());
+    isRunningSystems = true;
+    tickSystems.run(entities, elapsedTime);
+    isRunningSystems = false;
+    applyCommands();
+    updateStreaming();
+    ++tickCount;
+
+    AudioSystem& audio = AudioSystem::getInstance();
+    if (audio.getEnabled() && !audio.isMusicPlaying() && playlist.size() > 0)
     {
         const std::string currentMusicName = AudioSystem::getInstance().getCurrentMusic();
         if (currentMusicName.empty())
@@ -51,6 +319,761 @@ void Scene::update(const sf::Time& elapsedTime)
     }
 }
 
+static constexpr sf::Uint32 STATE_MAGIC = 0x31534353; // "SCS1"
+
+namespace
+{
+    struct EntityState
+    {
+        EntityHandle handle;
+        Signature signature = 0;
+        PrefabId prefab = INVALID_PREFAB;
+        EntityHandle parent;
+        sf::Vector2f position;
+        float rotation = 0.0f;
+
+        b2Vec2 bodyPosition;
+        float bodyAngle = 0.0f;
+        b2Vec2 linearVelocity;
+        float angularVelocity = 0.0f;
+        sf::Uint8 isAwake = 0;
+        sf::Uint8 isEnabled = 0;
+        Body body;
+
+        Animation::State animation;
+    };
+}
+
+void Scene::saveState(SceneState& state) const
+{
+    sf::Clock clock;
+    state.data.clear();
+    state.write(STATE_MAGIC);
+    state.write(tickCount);
+
+    const std::uint32_t numSlots = entities.getNumSlots();
+    state.write(numSlots);
+    for (std::uint32_t index = 0; index < numSlots; ++index)
+    {
+        state.write(entities.getGeneration(index));
+    }
+    const std::vector<std::uint32_t>& freeSlots = entities.getFreeSlots();
+    state.write(static_cast<std::uint32_t>(freeSlots.size()));
+    for (std::uint32_t index : freeSlots)
+    {
+        state.write(index);
+    }
+
+    state.write(static_cast<std::uint32_t>(entities.size()));
+    for (const Archetype& archetype : entities.getArchetypes())
+    {
+        const bool hasBody = archetype.has(signatureOf(Component::Type::BODY));
+        const bool hasAnimation = archetype.has(signatureOf(Component::Type::ANIMATION));
+        for (std::size_t row = 0; row < archetype.size(); ++row)
+        {
+            const EntityHandle handle = archetype.entities[row];
+            state.write(handle);
+            state.write(archetype.signature);
+            state.write((handle.index < instancePrefabs.size()) ? instancePrefabs[handle.index] : INVALID_PREFAB);
+            state.write(entities.getParent(handle));
+            state.write(archetype.positions[row]);
+            state.write(archetype.rotations[row]);
+
+            if (hasBody)
+            {
+                const Body& body = archetype.column<Component::Type::BODY>()[row];
+                state.write(body.pBody->GetPosition());
+                state.write(body.pBody->GetAngle());
+                state.write(body.pBody->GetLinearVelocity());
+                state.write(body.pBody->GetAngularVelocity());
+                state.write(static_cast<sf::Uint8>(body.pBody->IsAwake()));
+                state.write(static_cast<sf::Uint8>(body.pBody->IsEnabled()));
+                state.write(body.velocity);
+                state.write(body.previousState);
+                state.write(body.currentState);
+            }
+            if (hasAnimation)
+            {
+                state.write(archetype.column<Component::Type::ANIMATION>()[row].getState());
+            }
+        }
+    }
+
+    stateStats.numBytes = state.data.size();
+    stateStats.saveTime = clock.getElapsedTime();
+}
+
+bool Scene::restoreState(const SceneState& state)
+{
+    sf::Clock clock;
+    std::size_t offset = 0;
+
+    sf::Uint32 magic = 0;
+    sf::Uint64 savedTick = 0;
+    std::uint32_t numSlots = 0;
+    bool isValid = state.read(offset, magic) && magic == STATE_MAGIC
+                && state.read(offset, savedTick)
+                && state.read(offset, numSlots);
+
+    std::vector<std::uint32_t> generations(isValid ? numSlots : 0);
+    for (std::uint32_t& generation : generations)
+    {
+        isValid = isValid && state.read(offset, generation);
+    }
+    std::uint32_t numFree = 0;
+    isValid = isValid && state.read(offset, numFree) && numFree <= numSlots;
+    std::vector<std::uint32_t> freeOrder(isValid ? numFree : 0);
+    for (std::uint32_t& index : freeOrder)
+    {
+        isValid = isValid && state.read(offset, index);
+    }
+
+    std::uint32_t numEntities = 0;
+    isValid = isValid && state.read(offset, numEntities) && numEntities <= numSlots;
+    std::vector<EntityState> records(isValid ? numEntities : 0);
+    for (EntityState& record : records)
+    {
+        isValid = isValid
+            && state.read(offset, record.handle) && record.handle.index < numSlots
+            && state.read(offset, record.signature)
+            && state.read(offset, record.prefab)
+            && state.read(offset, record.parent)
+            && state.read(offset, record.position)
+            && state.read(offset, record.rotation);
+        if (isValid && (record.signature & signatureOf(Component::Type::BODY)) != 0)
+        {
+            isValid = state.read(offset, record.bodyPosition)
+                   && state.read(offset, record.bodyAngle)
+                   && state.read(offset, record.linearVelocity)
+                   && state.read(offset, record.angularVelocity)
+                   && state.read(offset, record.isAwake)
+                   && state.read(offset, record.isEnabled)
+                   && state.read(offset, record.body.velocity)
+                   && state.read(offset, record.body.previousState)
+                   && state.read(offset, record.body.currentState);
+        }
+        if (isValid && (record.signature & signatureOf(Component::Type::ANIMATION)) != 0)
+        {
+            isValid = state.read(offset, record.animation);
+        }
+    }
+    if (!isValid)
+    {
+        LOG_ERROR("corrupt scene state");
+        return false;
+    }
+
+    // Everything is checked before the scene is touched.
+    for (const EntityState& record : records)
+    {
+        // Parked or not, streaming settles that again after the restore.
+        const Signature signature = record.signature & ~INACTIVE;
+        const bool isRestorable = entities.isAlive(record.handle)
+            ? (entities.getSignature(record.handle) & ~INACTIVE) == signature
+            : record.prefab < prefabs.size() && prefabs[record.prefab].signature == signature;
+        if (!isRestorable)
+        {
+            LOG_WARNING(std::string("scene state does not match the level: ") + state.level);
+            return false;
+        }
+    }
+
+    commands.clear();
+
+    // Entities created after the save, including ones that took a saved slot.
+    std::vector<std::uint32_t> savedGenerations(entities.getNumSlots(), std::numeric_limits<std::uint32_t>::max());
+    for (const EntityState& record : records)
+    {
+        if (record.handle.index < savedGenerations.size()) savedGenerations[record.handle.index] = record.handle.generation;
+    }
+    for (std::uint32_t index = 0; index < savedGenerations.size(); ++index)
+    {
+        const EntityHandle handle = entities.getHandle(index);
+        if (handle != INVALID_ENTITY && handle.generation != savedGenerations[index]) destroyEntity(handle);
+    }
+
+    for (const EntityState& record : records)
+    {
+        if (entities.isAlive(record.handle)) continue;
+
+        SpawnDesc spawn;
+        spawn.position = record.position;
+        spawn.rotation = record.rotation;
+        entities.reserveSlot(record.handle);
+        instantiate(record.prefab, spawn);
+    }
+
+    for (const EntityState& record : records)
+    {
+        if (entities.getParent(record.handle) != record.parent) entities.setParent(record.handle, record.parent);
+        setEntityActive(record.handle, (record.signature & INACTIVE) == 0);
+        entities.setLocalTransform(record.handle, record.position, record.rotation);
+
+        Body* pBody = entities.getComponent<Component::Type::BODY>(record.handle);
+        if (pBody != nullptr)
+        {
+            b2Body& body = *pBody->pBody;
+            body.SetEnabled(record.isEnabled != 0);
+            body.SetTransform(record.bodyPosition, record.bodyAngle);
+            body.SetLinearVelocity(record.linearVelocity);
+            body.SetAngularVelocity(record.angularVelocity);
+
+            // Putting a body to sleep also clears its velocity, as the solver does.
+            body.SetAwake(record.isAwake != 0);
+            wakeBody(record.handle);
+            pBody->velocity = record.body.velocity;
+            pBody->previousState = record.body.previousState;
+            pBody->currentState = record.body.currentState;
+        }
+
+        Animation* pAnimation = entities.getComponent<Component::Type::ANIMATION>(record.handle);
+        if (pAnimation != nullptr) pAnimation->setState(record.animation);
+    }
+
+    if (!entities.restoreSlots(generations, freeOrder))
+    {
+        LOG_WARNING("scene state slot table was not restored");
+    }
+    tickCount = savedTick;
+    streaming.invalidate();
+
+    stateStats.numBytes = state.data.size();
+    stateStats.restoreTime = clock.getElapsedTime();
+    return true;
+}
+
+void Scene::applyCommands()
+{
+    EntityCommands::Batch& batch = commands.collect();
+
+    for (EntityHandle handle : batch.destroyed)
+    {
+        destroyEntity(handle);
+    }
+
+    for (const auto& [handle, type] : batch.removed)
+    {
+        Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+        if (type == Component::Type::BODY && pBody != nullptr) world.DestroyBody(pBody->pBody);
+        if (!entities.removeComponent(handle, type)) continue;
+
+        std::uint32_t archetypeIdx, row;
+        entities.getLocation(handle, archetypeIdx, row);
+        if (!isDrawable(entities.getArchetypes()[archetypeIdx])) drawGrid.remove(handle);
+    }
+
+    for (auto& [handle, component] : batch.added)
+    {
+        // The replaced body would be lost with its component.
+        Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+        if (component.getType() == Component::Type::BODY && pBody != nullptr) world.DestroyBody(pBody->pBody);
+        if (entities.addComponent(handle, std::move(component))) registerEntity(handle);
+    }
+
+    for (const auto& [prefabId, spawn] : batch.instantiated)
+    {
+        instantiate(prefabId, spawn);
+    }
+
+    for (EntityDesc& desc : batch.spawned)
+    {
+        createEntity(std::move(desc));
+    }
+}
+
+void Scene::streamEntity(EntityHandle handle, EntityHandle parent)
+{
+    if (!streaming.isEnabled() || !entities.isAlive(handle)) return;
+    if (parent != INVALID_ENTITY)
+    {
+        streaming.addChild(handle, parent);
+        return;
+    }
+
+    std::uint32_t archetypeIdx, row;
+    entities.getLocation(handle, archetypeIdx, row);
+    const Archetype& archetype = entities.getArchetypes()[archetypeIdx];
+
+    // Whatever the camera or the player follows must never be parked.
+    if ((archetype.signature & signatureOf(Component::Type::CAMERA, Component::Type::CONTROLLER)) != 0) return;
+
+    const sf::Vector2f position = archetype.getTransform(row).transformPoint(0.0f, 0.0f);
+    sf::FloatRect bounds = isDrawable(archetype) ? computeBounds(archetype, row) : sf::FloatRect(position, { 0.0f, 0.0f });
+    const Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+    for (const b2Fixture* pFixture = (pBody != nullptr) ? pBody->pBody->GetFixtureList() : nullptr; pFixture != nullptr; pFixture = pFixture->GetNext())
+    {
+        const b2AABB& aabb = pFixture->GetAABB(0);
+        const b2Vec2 size = aabb.upperBound - aabb.lowerBound;
+        bounds = unite(bounds, { aabb.lowerBound.x * SCALE_FACTOR, aabb.lowerBound.y * SCALE_FACTOR, size.x * SCALE_FACTOR, size.y * SCALE_FACTOR });
+    }
+    streaming.add(handle, bounds);
+}
+
+void Scene::setEntityActive(EntityHandle handle, bool isActive)
+{
+    if (!entities.isAlive(handle) || entities.isActive(handle) == isActive) return;
+
+    entities.setActive(handle, isActive);
+    Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+    if (pBody != nullptr) pBody->pBody->SetEnabled(isActive);
+    if (isActive) wakeBody(handle);
+
+    if (!isActive)
+    {
+        drawGrid.remove(handle);
+        return;
+    }
+
+    // The parent may have moved while this one was parked.
+    entities.markDirty(handle);
+    std::uint32_t archetypeIdx, row;
+    entities.getLocation(handle, archetypeIdx, row);
+    const Archetype& archetype = entities.getArchetypes()[archetypeIdx];
+    if (isDrawable(archetype)) drawGrid.update(handle, computeBounds(archetype, row));
+}
+
+void Scene::updateStreaming()
+{
+    if (!streaming.isEnabled()) return;
+
+    // Taken from simulated state only: the render camera is interpolated and
+    // never runs headless, replays have to park the same regions as live runs.
+    sf::Vector2f center;
+    bool hasCamera = false;
+    entities.forEach(cameraQuery, [&center, &hasCamera](const Archetype& archetype)
+    {
+        if (hasCamera) return;
+        hasCamera = true;
+
+        sf::Transform transform = archetype.getTransform(0);
+        if (archetype.has(signatureOf(Component::Type::BODY)))
+        {
+            const BodyState& state = archetype.column<Component::Type::BODY>()[0].currentState;
+            transform = sf::Transform::Identity;
+            transform.translate(meterToPixel(state.position.x), meterToPixel(state.position.y));
+            transform.rotate(radianToDegree(state.angle));
+        }
+        center = transform.transformPoint(archetype.column<Component::Type::CAMERA>()[0].getCenter());
+    });
+
+    // Without a camera the default view is centred on the window.
+    if (!hasCamera) center = sf::Vector2f(static_cast<float>(WINDOW_CONFIG.w), static_cast<float>(WINDOW_CONFIG.h)) / 2.0f;
+
+    // Bodies pushed into another region live and park with that one, their
+    // descendants without a body of their own come along.
+    for (EntityHandle handle : movingBodies)
+    {
+        const Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+        if (pBody == nullptr) continue;
+        const b2Vec2& position = pBody->currentState.position;
+        if (!streaming.move(handle, { position.x * SCALE_FACTOR, position.y * SCALE_FACTOR })) continue;
+
+        streamingMoved.assign(1, handle);
+        for (std::size_t idx = 0; idx < streamingMoved.size(); ++idx)
+        {
+            for (EntityHandle child : entities.getChildren(streamingMoved[idx]))
+            {
+                if (entities.getComponent<Component::Type::BODY>(child) != nullptr) continue;
+                streaming.addChild(child, handle);
+                streamingMoved.push_back(child);
+            }
+        }
+        if (streaming.isLive(handle)) continue;
+        for (EntityHandle moved : streamingMoved)
+        {
+            setEntityActive(moved, false);
+        }
+    }
+    streaming.update(center, streamingTransitions);
+    for (const LevelStreaming::Transition& transition : streamingTransitions)
+    {
+        std::vector<EntityHandle>& regionEntities = streaming.getEntities(transition.region);
+        auto lastIt = std::remove_if(regionEntities.begin(), regionEntities.end(), [this](EntityHandle handle) { return !entities.isAlive(handle); });
+        regionEntities.erase(lastIt, regionEntities.end());
+
+        for (EntityHandle handle : regionEntities)
+        {
+            setEntityActive(handle, transition.isActive);
+        }
+    }
+}
+
+void Scene::stepPhysics(const sf::Time& elapsedTime)
+{
+    world.Step(elapsedTime.asSeconds(), quality.velocityIterations, quality.positionIterations);
+}
+
+void Scene::dispatchContacts()
+{
+    contacts.sort();
+    for (ContactHandler& handler : contactHandlers)
+    {
+        handler(*this, contacts);
+    }
+    contacts.clear();
+}
+
+void Scene::updateBodies()
+{
+    const std::size_t firstWoken = movingBodies.size();
+    for (EntityHandle handle : contacts.getTouched())
+    {
+        wakeBody(handle);
+    }
+    contacts.clearTouched();
+
+    // The solver wakes whole islands, contacts between two sleeping bodies
+    // were never reported. Follow them from every newly woken body.
+    for (std::size_t idx = firstWoken; idx < movingBodies.size(); ++idx)
+    {
+        const Body* pBody = entities.getComponent<Component::Type::BODY>(movingBodies[idx]);
+        for (b2ContactEdge* pEdge = pBody->pBody->GetContactList(); pEdge != nullptr; pEdge = pEdge->next)
+        {
+            if (!pEdge->contact->IsTouching()) continue;
+            const std::uintptr_t index = reinterpret_cast<std::uintptr_t>(pEdge->other->GetUserData());
+            wakeBody(entities.getHandle(static_cast<std::uint32_t>(index)));
+        }
+    }
+
+    isResting.resize(movingBodies.size());
+    JOBS.parallelFor(movingBodies.size(), SYSTEM_GRAIN_SIZE, [this](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t idx = begin; idx < end; ++idx)
+        {
+            Body* pBody = entities.getComponent<Component::Type::BODY>(movingBodies[idx]);
+            if (pBody == nullptr || !pBody->pBody->IsEnabled() || pBody->pBody->GetType() == b2_staticBody)
+            {
+                isResting[idx] = 1;
+                continue;
+            }
+
+            Body& body = *pBody;
+            body.previousState = body.currentState;
+            body.currentState = { body.pBody->GetPosition(), body.pBody->GetAngle() };
+            body.velocity = body.pBody->GetLinearVelocity();
+
+            // Kept one more tick after falling asleep, interpolation has to reach the resting state.
+            const bool isStill = body.previousState.position == body.currentState.position && body.previousState.angle == body.currentState.angle;
+            isResting[idx] = (!body.pBody->IsAwake() && isStill) ? 1 : 0;
+        }
+    });
+
+    std::size_t numMoving = 0;
+    for (std::size_t idx = 0; idx < movingBodies.size(); ++idx)
+    {
+        const EntityHandle handle = movingBodies[idx];
+        if (isResting[idx] != 0)
+        {
+            movingSlots[handle.index] = NOT_MOVING;
+            continue;
+        }
+        movingSlots[handle.index] = static_cast<std::uint32_t>(numMoving);
+        movingBodies[numMoving++] = handle;
+    }
+    movingBodies.resize(numMoving);
+}
+
+void Scene::updateAnimations(const sf::Time& elapsedTime)
+{
+    const int animationInterval = quality.animationInterval;
+    if (tickCount % animationInterval != 0) return;
+
+    const sf::Time animationTime = elapsedTime * static_cast<float>(animationInterval);
+    entities.forEach(animationQuery, [&animationTime](Archetype& archetype)
+    {
+        std::vector<Animation>& animations = archetype.column<Component::Type::ANIMATION>();
+        const std::vector<Body>& bodies = archetype.column<Component::Type::BODY>();
+        const bool hasBody = archetype.has(signatureOf(Component::Type::BODY));
+        JOBS.parallelFor(animations.size(), SYSTEM_GRAIN_SIZE, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t row = begin; row < end; ++row)
+            {
+                animations[row].update(hasBody ? bodies[row].velocity : b2Vec2(0.0f, 0.0f), animationTime);
+            }
+        });
+    });
+}
+
+void Scene::updateControllers()
+{
+    entities.forEach(controllerQuery, [this](Archetype& archetype)
+    {
+        std::vector<ControlActions>& controllers = archetype.column<Component::Type::CONTROLLER>();
+        for (std::size_t row = 0; row < controllers.size(); ++row)
+        {
+            for (auto& [key, actions] : controllers[row])
+            {
+                for (auto& action : actions) action(*this, archetype.entities[row], IS_KEY_PRESSED(key));
+            }
+        }
+    });
+}
+
+void Scene::interpolate(float alpha)
+{
+    interpolationAlpha = alpha;
+    isRunningSystems = true;
+    frameSystems.run(entities, sf::Time::Zero);
+    isRunningSystems = false;
+}
+
+void Scene::interpolateBodies()
+{
+    // Each job gathers its range into bodyTransforms, converts it in one pass
+    // and writes it back. Rows never repeat in movingBodies, so jobs write disjoint rows.
+    const float alpha = interpolationAlpha;
+    bodyTransforms.resize(movingBodies.size());
+    movingRows.resize(movingBodies.size());
+    JOBS.parallelFor(movingBodies.size(), SYSTEM_GRAIN_SIZE, [this, alpha](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t idx = begin; idx < end; ++idx)
+        {
+            std::uint32_t archetypeIdx, row;
+            if (!entities.getLocation(movingBodies[idx], archetypeIdx, row))
+            {
+                movingRows[idx] = NO_ROW;
+                bodyTransforms.set(idx, BodyState(), BodyState());
+                continue;
+            }
+            movingRows[idx] = (static_cast<sf::Uint64>(archetypeIdx) << 32) | row;
+            const Body& body = entities.getArchetypeAt(archetypeIdx).column<Component::Type::BODY>()[row];
+            bodyTransforms.set(idx, body.previousState, body.currentState);
+        }
+
+        bodyTransforms.convert(alpha, begin, end);
+
+        for (std::size_t idx = begin; idx < end; ++idx)
+        {
+            const sf::Uint64 key = movingRows[idx];
+            if (key == NO_ROW) continue;
+
+            Archetype& archetype = entities.getArchetypeAt(static_cast<std::uint32_t>(key >> 32));
+            const std::size_t row = static_cast<std::size_t>(key & 0xFFFFFFFF);
+            const sf::Vector2f position = bodyTransforms.getPosition(idx);
+            const float rotation = bodyTransforms.getRotation(idx);
+
+            // Bodies pushed but not moved keep their cached world transform.
+            if (position == archetype.positions[row] && rotation == archetype.rotations[row]) continue;
+            archetype.positions[row] = position;
+            archetype.rotations[row] = rotation;
+            if (archetype.isDirty[row] == 0) archetype.isDirty[row] = 1;
+        }
+    });
+}
+
+void Scene::updateTransforms()
+{
+    changedTransforms.clear();
+    entities.updateTransforms(movingBodies, changedTransforms);
+}
+
+void Scene::updateCamera()
+{
+    entities.forEach(cameraQuery, [this](const Archetype& archetype)
+    {
+        const std::vector<sf::View>& cameras = archetype.column<Component::Type::CAMERA>();
+        for (std::size_t row = 0; row < cameras.size(); ++row)
+        {
+            setCamera(archetype.getTransform(row), cameras[row]);
+        }
+    });
+}
+
+void Scene::queryArea(const sf::FloatRect& area, std::vector<EntityHandle>& result) const
+{
+    struct Callback : public b2QueryCallback
+    {
+        bool ReportFixture(b2Fixture* fixture) override
+        {
+            // The broadphase tests fat AABBs, check the real one.
+            if (!b2TestOverlap(fixture->GetAABB(0), aabb)) return true;
+
+            const std::uintptr_t index = reinterpret_cast<std::uintptr_t>(fixture->GetBody()->GetUserData());
+            const EntityHandle handle = pEntities->getHandle(static_cast<std::uint32_t>(index));
+            if (handle != INVALID_ENTITY) pResult->push_back(handle);
+            return true;
+        }
+
+        b2AABB aabb;
+        const EntityStorage* pEntities;
+        std::vector<EntityHandle>* pResult;
+    };
+
+    Callback callback;
+    callback.aabb.lowerBound = { area.left / SCALE_FACTOR, area.top / SCALE_FACTOR };
+    callback.aabb.upperBound = { (area.left + area.width) / SCALE_FACTOR, (area.top + area.height) / SCALE_FACTOR };
+    callback.pEntities = &entities;
+    callback.pResult = &result;
+    const std::size_t firstResult = result.size();
+    world.QueryAABB(&callback, callback.aabb);
+
+    // A body with several overlapping fixtures is reported once per fixture.
+    auto byIndex = [](EntityHandle left, EntityHandle right) { return left.index < right.index; };
+    std::sort(result.begin() + firstResult, result.end(), byIndex);
+    result.erase(std::unique(result.begin() + firstResult, result.end()), result.end());
+
+    // Bodies were answered above, keep only the rest from the grid.
+    const std::size_t firstGridResult = result.size();
+    drawGrid.query(area, result);
+    auto lastIt = std::remove_if(result.begin() + firstGridResult, result.end(), [this](EntityHandle handle)
+    {
+        return (entities.getSignature(handle) & signatureOf(Component::Type::BODY)) != 0;
+    });
+    result.erase(lastIt, result.end());
+}
+
+void Scene::queryRadius(const sf::Vector2f& center, float radius, std::vector<EntityHandle>& result) const
+{
+    const std::size_t firstResult = result.size();
+    queryArea({ center.x - radius, center.y - radius, 2.0f * radius, 2.0f * radius }, result);
+
+    // Distance from the centre to the closest point of the bounds, zero inside them.
+    auto lastIt = std::remove_if(result.begin() + firstResult, result.end(), [this, &center, radius](EntityHandle handle)
+    {
+        sf::FloatRect bounds;
+        if (!getEntityBounds(handle, bounds)) return true;
+        const sf::Vector2f closest(std::max(bounds.left, std::min(center.x, bounds.left + bounds.width)),
+                                   std::max(bounds.top, std::min(center.y, bounds.top + bounds.height)));
+        const sf::Vector2f offset = closest - center;
+        return offset.x * offset.x + offset.y * offset.y > radius * radius;
+    });
+    result.erase(lastIt, result.end());
+}
+
+void Scene::queryNearest(const sf::Vector2f& center, std::size_t count, std::vector<EntityHandle>& result) const
+{
+    if (count == 0) return;
+
+    // Grow the radius until enough positions lie inside it, everything closer
+    // than the radius is then guaranteed to be among the candidates. Bounds
+    // that merely touch the circle are gathered too, but do not count.
+    static constexpr int MAX_DOUBLINGS = 12;
+    std::vector<std::pair<float, EntityHandle>> candidates;
+    std::vector<EntityHandle> found;
+    float radius = drawGrid.getCellSize();
+    for (int attempt = 0; attempt < MAX_DOUBLINGS; ++attempt, radius *= 2.0f)
+    {
+        found.clear();
+        candidates.clear();
+        queryRadius(center, radius, found);
+
+        std::size_t numInside = 0;
+        for (EntityHandle handle : found)
+        {
+            sf::Vector2f position;
+            getEntityPosition(handle, position);
+            const sf::Vector2f offset = position - center;
+            const float distanceSquared = offset.x * offset.x + offset.y * offset.y;
+            if (distanceSquared <= radius * radius) ++numInside;
+            candidates.emplace_back(distanceSquared, handle);
+        }
+        if (numInside >= count || found.size() >= entities.size()) break;
+    }
+
+    const std::size_t numNearest = std::min(count, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + numNearest, candidates.end(),
+                      [](const auto& left, const auto& right) { return left.first < right.first; });
+    for (std::size_t idx = 0; idx < numNearest; ++idx)
+    {
+        result.push_back(candidates[idx].second);
+    }
+}
+
+bool Scene::getEntityPosition(EntityHandle handle, sf::Vector2f& position) const
+{
+    const Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+    if (pBody != nullptr)
+    {
+        const b2Vec2& bodyPosition = pBody->pBody->GetPosition();
+        position = { bodyPosition.x * SCALE_FACTOR, bodyPosition.y * SCALE_FACTOR };
+        return true;
+    }
+    if (drawGrid.contains(handle))
+    {
+        const sf::FloatRect& bounds = drawGrid.getBounds(handle);
+        position = { bounds.left + bounds.width / 2.0f, bounds.top + bounds.height / 2.0f };
+        return true;
+    }
+    return false;
+}
+
+bool Scene::getEntityBounds(EntityHandle handle, sf::FloatRect& bounds) const
+{
+    const Body* pBody = entities.getComponent<Component::Type::BODY>(handle);
+    if (pBody != nullptr)
+    {
+        const b2Fixture* pFixture = pBody->pBody->GetFixtureList();
+        if (pFixture == nullptr) return false;
+
+        b2AABB aabb = pFixture->GetAABB(0);
+        for (pFixture = pFixture->GetNext(); pFixture != nullptr; pFixture = pFixture->GetNext())
+        {
+            aabb.Combine(pFixture->GetAABB(0));
+        }
+        bounds = sf::FloatRect(aabb.lowerBound.x * SCALE_FACTOR, aabb.lowerBound.y * SCALE_FACTOR,
+                               (aabb.upperBound.x - aabb.lowerBound.x) * SCALE_FACTOR,
+                               (aabb.upperBound.y - aabb.lowerBound.y) * SCALE_FACTOR);
+        return true;
+    }
+    if (drawGrid.contains(handle))
+    {
+        bounds = drawGrid.getBounds(handle);
+        return true;
+    }
+    return false;
+}
+
+void Scene::updateDrawGrid()
+{
+    const std::vector<Archetype>& archetypes = entities.getArchetypes();
+    for (EntityHandle handle : changedTransforms)
+    {
+        std::uint32_t archetypeIdx, row;
+        if (!entities.getLocation(handle, archetypeIdx, row)) continue;
+
+        const Archetype& archetype = archetypes[archetypeIdx];
+        if (isDrawable(archetype)) drawGrid.update(handle, computeBounds(archetype, row));
+    }
+}
+
+sf::FloatRect Scene::computeBounds(const Archetype& archetype, std::size_t row) const
+{
+    sf::FloatRect bounds;
+    bool isEmpty = true;
+    auto addBounds = [&bounds, &isEmpty](const sf::FloatRect& rect)
+    {
+        bounds = isEmpty ? rect : unite(bounds, rect);
+        isEmpty = false;
+    };
+
+    if (archetype.has(signatureOf(Component::Type::SHAPE))) addBounds(archetype.column<Component::Type::SHAPE>()[row].getGlobalBounds());
+    if (archetype.has(signatureOf(Component::Type::SPRITE))) addBounds(archetype.column<Component::Type::SPRITE>()[row].getGlobalBounds());
+    if (archetype.has(signatureOf(Component::Type::ANIMATION))) addBounds(archetype.column<Component::Type::ANIMATION>()[row].getSprite().getGlobalBounds());
+
+    return archetype.getTransform(row).transformRect(bounds);
+}
+
+void Scene::collectVisible() const
+{
+    visibleEntities.clear();
+    drawGrid.query(getVisibleArea(), visibleEntities);
+
+    visibleRows.clear();
+    for (EntityHandle handle : visibleEntities)
+    {
+        std::uint32_t archetypeIdx, row;
+        if (entities.getLocation(handle, archetypeIdx, row))
+        {
+            visibleRows.emplace_back(entities.getDrawOrder(handle), (static_cast<sf::Uint64>(archetypeIdx) << 32) | row);
+        }
+    }
+    // Entities draw in creation order, the grid returns them by cell and rows move.
+    std::sort(visibleRows.begin(), visibleRows.end());
+
+    cullStats.numDrawn = visibleRows.size();
+    cullStats.numCulled = drawGrid.size() - visibleRows.size();
+}
+
 void Scene::draw(sf::RenderTarget& target, sf::RenderStates states) const
 {
     sf::RenderStates renderState = states;
@@ -61,23 +1084,111 @@ void Scene::draw(sf::RenderTarget& target, sf::RenderStates states) const
     sceneView.setViewport(viewport);
     target.setView(sceneView);
 
-    for (auto& entity : sceneGraph)
+    collectVisible();
+    for (const auto& visible : visibleRows)
     {
-        target.draw(entity, renderState);
+        const sf::Uint64 key = visible.second;
+        const Archetype& archetype = entities.getArchetypes()[key >> 32];
+        const std::size_t row = static_cast<std::size_t>(key & 0xFFFFFFFF);
+
+        sf::RenderStates entityState = renderState;
+        entityState.transform *= archetype.getTransform(row);
+        if (archetype.has(signatureOf(Component::Type::SHAPE))) target.draw(archetype.column<Component::Type::SHAPE>()[row], entityState);
+        if (archetype.has(signatureOf(Component::Type::SPRITE))) target.draw(archetype.column<Component::Type::SPRITE>()[row], entityState);
+        if (archetype.has(signatureOf(Component::Type::ANIMATION))) target.draw(archetype.column<Component::Type::ANIMATION>()[row], entityState);
     }
 
     target.setView(prevView);
 }
 
+void Scene::capture(SceneSnapshot& snapshot) const
+{
+    snapshot.clear();
+    snapshot.transform = getTransform() * cameraTransform.getInverse();
+    snapshot.view = view;
+    snapshot.view.setViewport(viewport);
+
+    collectVisible();
+    for (const auto& visible : visibleRows)
+    {
+        const sf::Uint64 key = visible.second;
+        const Archetype& archetype = entities.getArchetypes()[key >> 32];
+        const std::size_t row = static_cast<std::size_t>(key & 0xFFFFFFFF);
+
+        const sf::Transform transform = archetype.getTransform(row);
+        if (archetype.has(signatureOf(Component::Type::SHAPE)))
+        {
+            SceneSnapshot::Item& item = snapshot.nextItem();
+            item.transform = transform;
+            item.drawable = archetype.column<Component::Type::SHAPE>()[row];
+        }
+        if (archetype.has(signatureOf(Component::Type::SPRITE)))
+        {
+            SceneSnapshot::Item& item = snapshot.nextItem();
+            item.transform = transform;
+            item.drawable = archetype.column<Component::Type::SPRITE>()[row];
+        }
+        if (archetype.has(signatureOf(Component::Type::ANIMATION)))
+        {
+            SceneSnapshot::Item& item = snapshot.nextItem();
+            item.transform = transform;
+            item.drawable = archetype.column<Component::Type::ANIMATION>()[row].getSprite();
+        }
+    }
+}
+
+sf::FloatRect Scene::getVisibleArea() const
+{
+    const sf::Vector2f viewSize = view.getSize();
+    const sf::FloatRect viewArea(view.getCenter() - viewSize / 2.0f, viewSize);
+    const sf::Transform worldToView = getTransform() * cameraTransform.getInverse();
+    return worldToView.getInverse().transformRect(viewArea);
+}
+
 void Scene::setCamera(const sf::Transform& transform, const sf::View& view)
 {
     cameraTransform = transform;
     this->view = view;
 }
 
+sf::Uint64 Scene::computeChecksum() const
+{
+    // FNV-1a over the raw bits of every body state, equal only for bit-identical runs.
+    sf::Uint64 hash = 14695981039346656037ULL;
+    auto hashBytes = [&hash](const void* data, std::size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t idx = 0; idx < size; ++idx)
+        {
+            hash = (hash ^ bytes[idx]) * 1099511628211ULL;
+        }
+    };
+
+    for (const b2Body* body = world.GetBodyList(); body != nullptr; body = body->GetNext())
+    {
+        const b2Transform& transform = body->GetTransform();
+        const b2Vec2& velocity = body->GetLinearVelocity();
+        hashBytes(&transform, sizeof(transform));
+        hashBytes(&velocity, sizeof(velocity));
+    }
+    return hash;
+}
+
 void Scene::clear()
 {
-    sceneGraph.clear();
+    entities.clear();
+    drawGrid.clear();
+    changedTransforms.clear();
+
+    commands.clear();
+    streaming.configure(LevelStreaming::Settings());
+
+    // Pooled bodies go with the rest of the world below.
+    prefabs.clear();
+    prefabIndex.clear();
+    instancePrefabs.clear();
+    movingBodies.clear();
+    movingSlots.clear();
 
     view = GAME_INSTANCE.window.getDefaultView();
     viewport = { 0.0f, 0.0f, 1.0f, 1.0f };
@@ -94,6 +1205,9 @@ void Scene::clear()
         body = nextBody;
     }
 
+    // After the bodies, destroying them reports the end of their contacts.
+    contacts.reset();
+    contactHandlers.clear();
 
     while (!menuStack.empty()) menuStack.pop();
 
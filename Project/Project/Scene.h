@@ -1,27 +1,163 @@
 #pragma once
 
 #include "Entity.h"
+#include "RenderSnapshot.h"
 #include <box2d/box2d.h>
 #include <vector>
 #include "UiManager.h"
+#include "FrameGovernor.h"
+#include "SystemPipeline.h"
+#include "SpatialGrid.h"
+#include "Prefab.h"
+#include "EntityCommands.h"
+#include "SceneState.h"
+#include "LevelStreaming.h"
+#include "ContactEvents.h"
+#include "BodyTransforms.h"
 #include <string>
 #include <unordered_map>
 
-struct Entity;
-
 struct Scene : public sf::Drawable, public sf::Transformable
 {
-    Entity* getEntity(const std::string& entityName);
+    Scene();
+
+    struct CullStats
+    {
+        std::size_t numDrawn = 0;
+        std::size_t numCulled = 0;
+    };
+
+    struct StateStats
+    {
+        std::size_t numBytes = 0;
+        sf::Time saveTime;
+        sf::Time restoreTime;
+    };
+
+    EntityHandle getEntity(const std::string& entityName) const;
+
+    // Also registers drawables with the culling grid.
+    EntityHandle createEntity(EntityDesc desc);
+
+    // Also destroys the physics body, stale handles are ignored. Prefab
+    // instances go back to their pool with the body disabled instead.
+    void destroyEntity(EntityHandle handle);
+
+    // Puts a level entity under streaming, children follow their parent.
+    // Entities too large for a region, cameras and controlled ones stay active.
+    void streamEntity(EntityHandle handle, EntityHandle parent = INVALID_ENTITY);
+
+    // Parks or wakes an entity: its body is disabled and it leaves the culling
+    // grid and every query, its components stay where they are.
+    void setEntityActive(EntityHandle handle, bool isActive);
+
+    // Body sync and interpolation only visit awake dynamic and kinematic bodies.
+    // Contacts wake bodies on their own, code waking a body directly (forces,
+    // velocities, SetAwake) calls this afterwards. Ticks that write PHYSICS_WORLD only.
+    void wakeBody(EntityHandle handle);
+    std::size_t getNumMovingBodies() const { return movingBodies.size(); }
+
+    // Disables the template body and fills the pool with poolSize instances.
+    PrefabId addPrefab(const std::string& name, EntityDesc desc, std::size_t poolSize);
+    PrefabId getPrefab(const std::string& name) const;
+
+    // Takes an instance from the prefab's pool, allocating only when it is empty.
+    EntityHandle instantiate(PrefabId prefabId, const SpawnDesc& spawn);
+
+    // Grows the pool and the archetype once for the whole batch, handles are appended.
+    void instantiate(PrefabId prefabId, const std::vector<SpawnDesc>& spawns, std::vector<EntityHandle>& result);
+
+    // Spatial queries in world pixels, results are appended. Bodies are found
+    // through the b2World broadphase, everything else through drawGrid.
+    // queryRadius keeps everything whose bounds touch the circle. queryNearest
+    // ranks by distance to the body position or the drawable bounds centre
+    // and only stops growing its search once count of those lie inside it.
+    void queryArea(const sf::FloatRect& area, std::vector<EntityHandle>& result) const;
+    void queryRadius(const sf::Vector2f& center, float radius, std::vector<EntityHandle>& result) const;
+    void queryNearest(const sf::Vector2f& center, std::size_t count, std::vector<EntityHandle>& result) const;
+
+    // World position used by the spatial queries.
+    bool getEntityPosition(EntityHandle handle, sf::Vector2f& position) const;
+
+    // World bounds used by the spatial queries: the fixture AABBs of the body
+    // or the drawable bounds.
+    bool getEntityBounds(EntityHandle handle, sf::FloatRect& bounds) const;
+
+    // Binary copy of entities, transforms, body motion and sleep state and
+    // animation playback. Restoring expects the level the state was saved in:
+    // entities spawned since are destroyed, prefab instances despawned since
+    // come back from their pools into their old slots. When that is not enough
+    // (a level entity is gone for good or changed components) nothing is touched.
+    void saveState(SceneState& state) const;
+    bool restoreState(const SceneState& state);
 
     void update(const sf::Time& elapsedTime);
 
+    // Sync point for the structural changes recorded in commands, main thread only.
+    void applyCommands();
+
+    // Switches regions around the visible area, at the same sync point.
+    void updateStreaming();
+
+    // Called once per tick after the step with that tick's contacts. Handlers
+    // may read bodies and play sounds, structural changes go through commands.
+    using ContactHandler = std::function<void(Scene&, const ContactEvents&)>;
+    void addContactHandler(ContactHandler handler) { contactHandlers.push_back(std::move(handler)); }
+
+    void interpolate(float alpha);
+
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
 
+    void capture(SceneSnapshot& snapshot) const;
+
     void setCamera(const sf::Transform& transform, const sf::View& view);
 
     void clear();
 
-    std::vector<Entity> sceneGraph;
+    // World rectangle seen through the current camera and view.
+    sf::FloatRect getVisibleArea() const;
+
+    // Union of the entity's drawables in world space.
+    sf::FloatRect computeBounds(const Archetype& archetype, std::size_t row) const;
+
+    // Systems, each walks only the archetypes holding its components.
+    void stepPhysics(const sf::Time& elapsedTime);
+    void dispatchContacts();
+    void updateBodies();
+    void updateAnimations(const sf::Time& elapsedTime);
+    void updateControllers();
+    void interpolateBodies();
+    void updateTransforms();
+    void updateCamera();
+    void updateDrawGrid();
+
+    sf::Uint64 computeChecksum() const;
+
+    EntityStorage entities;
+
+    QueryId bodyQuery;
+    QueryId animationQuery;
+    QueryId controllerQuery;
+    QueryId cameraQuery;
+
+    // Systems must not create or destroy entities directly, they record here.
+    EntityCommands commands;
+
+    // Run once per simulation tick and once per rendered frame, in this order.
+    SystemPipeline tickSystems;
+    SystemPipeline frameSystems;
+    float interpolationAlpha = 1.0f;
+
+    // Entities whose world transform was recomputed this frame.
+    std::vector<EntityHandle> changedTransforms;
+
+    // Drawable bounds, queried with the visible area on every draw.
+    SpatialGrid drawGrid;
+    mutable CullStats cullStats;
+
+    mutable StateStats stateStats;
+
+    LevelStreaming streaming;
 
     sf::View view;
     sf::FloatRect viewport = { 0.0f, 0.0f, 1.0f, 1.0f };
@@ -29,8 +165,49 @@ struct Scene : public sf::Drawable, public sf::Transformable
 
     std::vector<std::string> playlist;
 
+    std::vector<Prefab> prefabs;
+
     b2World world = b2Vec2(0.0f, 0.0f);
+    ContactEvents contacts{ entities };
+    std::vector<ContactHandler> contactHandlers;
+
+    FrameGovernor::Knobs quality;
+    sf::Uint64 tickCount = 0;
+    // Set while systems run, structural changes go through commands then.
+    bool isRunningSystems = false;
 
     std::stack<Menu> menuStack;
     std::unordered_map<std::string, Menu> allMenu;
+
+private:
+    // Body user data and culling grid registration shared by every way of creating entities.
+    EntityHandle registerEntity(EntityHandle handle);
+
+    // Adds count ready instances with freshly cloned bodies.
+    void growPool(Prefab& prefab, std::size_t count);
+
+    std::unordered_map<std::string, PrefabId> prefabIndex;
+
+    std::vector<LevelStreaming::Transition> streamingTransitions;
+    std::vector<EntityHandle> streamingMoved;
+
+    // Prefab of each live instance by slot index, INVALID_PREFAB for other entities.
+    std::vector<PrefabId> instancePrefabs;
+
+    // Bodies synced every tick, a body that fell asleep leaves once its last
+    // two states match. movingSlots holds the position of each slot in
+    // movingBodies, entries of destroyed entities are dropped on the next sync.
+    std::vector<EntityHandle> movingBodies;
+    std::vector<std::uint32_t> movingSlots;
+    std::vector<std::uint8_t> isResting;
+
+    // Interpolation of movingBodies, (archetype, row) keys of their rows.
+    BodyTransforms bodyTransforms;
+    std::vector<sf::Uint64> movingRows;
+
+    // Fills visibleRows with (draw order, (archetype, row) key) of visible entities, sorted.
+    void collectVisible() const;
+
+    mutable std::vector<EntityHandle> visibleEntities;
+    mutable std::vector<std::pair<std::uint64_t, sf::Uint64>> visibleRows;
 };
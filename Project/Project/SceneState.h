@@ -0,0 +1,37 @@
+#pragma once
+
+#include <SFML/System.hpp>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary copy of the mutable scene state, written by Scene::saveState. Plain
+// values only: textures, controllers and the like stay with the level.
+struct SceneState
+{
+    std::vector<char> data;
+    std::string level;
+
+    bool isEmpty() const { return data.empty(); }
+
+    template<typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "scene state holds plain values only");
+        const std::size_t offset = data.size();
+        data.resize(offset + sizeof(T));
+        std::memcpy(data.data() + offset, &value, sizeof(T));
+    }
+
+    // Reading past the end leaves value untouched and returns false.
+    template<typename T>
+    bool read(std::size_t& offset, T& value) const
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "scene state holds plain values only");
+        if (offset + sizeof(T) > data.size()) return false;
+        std::memcpy(&value, data.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+
+// Inclusive like b2TestOverlap, so touching and zero-area rectangles count.
+static bool overlaps(const sf::FloatRect& left, const sf::FloatRect& right)
+{
+    return left.left <= right.left + right.width && right.left <= left.left + left.width
+        && left.top <= right.top + right.height && right.top <= left.top + left.height;
+}
+
+SpatialGrid::CellRange SpatialGrid::getCellRange(const sf::FloatRect& bounds) const
+{
+    // Clamped so absurd rectangles cannot overflow the cell coordinates.
+    static constexpr float MAX_CELL = 1 << 30;
+    auto toCell = [this](float coordinate)
+    {
+        return static_cast<int>(std::max(-MAX_CELL, std::min(MAX_CELL, std::floor(coordinate / cellSize))));
+    };
+
+    CellRange range;
+    range.left = toCell(bounds.left);
+    range.top = toCell(bounds.top);
+    range.right = toCell(bounds.left + bounds.width);
+    range.bottom = toCell(bounds.top + bounds.height);
+    return range;
+}
+
+sf::Uint64 SpatialGrid::getCellKey(int x, int y)
+{
+    return (static_cast<sf::Uint64>(static_cast<sf::Uint32>(x)) << 32) | static_cast<sf::Uint32>(y);
+}
+
+void SpatialGrid::link(std::uint32_t entryIdx, const CellRange& range)
+{
+    for (int x = range.left; x <= range.right; ++x)
+    {
+        for (int y = range.top; y <= range.bottom; ++y)
+        {
+            cells[getCellKey(x, y)].push_back(entryIdx);
+        }
+    }
+}
+
+void SpatialGrid::unlink(std::uint32_t entryIdx, const CellRange& range)
+{
+    for (int x = range.left; x <= range.right; ++x)
+    {
+        for (int y = range.top; y <= range.bottom; ++y)
+        {
+            auto cellIt = cells.find(getCellKey(x, y));
+            if (cellIt == cells.end()) continue;
+
+            std::vector<std::uint32_t>& cell = cellIt->second;
+            auto entryIt = std::find(cell.begin(), cell.end(), entryIdx);
+            if (entryIt != cell.end())
+            {
+                *entryIt = cell.back();
+                cell.pop_back();
+            }
+            if (cell.empty()) cells.erase(cellIt);
+        }
+    }
+}
+
+void SpatialGrid::update(EntityHandle handle, const sf::FloatRect& bounds)
+{
+    if (handle.index >= entries.size())
+    {
+        entries.resize(handle.index + 1);
+        queryStamps.resize(handle.index + 1, 0);
+    }
+
+    Entry& entry = entries[handle.index];
+    const CellRange range = getCellRange(bounds);
+    if (entry.isActive && entry.handle == handle)
+    {
+        entry.bounds = bounds;
+        if (entry.cells == range) return;
+        unlink(handle.index, entry.cells);
+    }
+    else
+    {
+        // The slot may still hold an entity destroyed without remove().
+        if (entry.isActive) unlink(handle.index, entry.cells);
+        else ++numEntries;
+        entry.isActive = true;
+        entry.handle = handle;
+        entry.bounds = bounds;
+    }
+
+    entry.cells = range;
+    link(handle.index, range);
+}
+
+void SpatialGrid::remove(EntityHandle handle)
+{
+    if (!contains(handle)) return;
+
+    Entry& entry = entries[handle.index];
+    unlink(handle.index, entry.cells);
+    entry.isActive = false;
+    --numEntries;
+}
+
+bool SpatialGrid::contains(EntityHandle handle) const
+{
+    return handle.index < entries.size() && entries[handle.index].isActive && entries[handle.index].handle == handle;
+}
+
+void SpatialGrid::query(const sf::FloatRect& area, std::vector<EntityHandle>& result) const
+{
+    if (++queryStamp == 0)
+    {
+        std::fill(queryStamps.begin(), queryStamps.end(), 0);
+        queryStamp = 1;
+    }
+
+    auto visitCell = [this, &area, &result](const std::vector<std::uint32_t>& cell)
+    {
+        for (std::uint32_t entryIdx : cell)
+        {
+            if (queryStamps[entryIdx] == queryStamp) continue;
+            queryStamps[entryIdx] = queryStamp;
+
+            const Entry& entry = entries[entryIdx];
+            if (overlaps(entry.bounds, area)) result.push_back(entry.handle);
+        }
+    };
+
+    // Huge areas cover more cells than are occupied, walk the occupied ones instead.
+    const CellRange range = getCellRange(area);
+    const double numCells = (double(range.right) - range.left + 1) * (double(range.bottom) - range.top + 1);
+    if (numCells > static_cast<double>(cells.size()))
+    {
+        for (const auto& [key, cell] : cells) visitCell(cell);
+        return;
+    }
+
+    for (int x = range.left; x <= range.right; ++x)
+    {
+        for (int y = range.top; y <= range.bottom; ++y)
+        {
+            auto cellIt = cells.find(getCellKey(x, y));
+            if (cellIt != cells.end()) visitCell(cellIt->second);
+        }
+    }
+}
+
+void SpatialGrid::clear()
+{
+    entries.clear();
+    cells.clear();
+    queryStamps.clear();
+    queryStamp = 0;
+    numEntries = 0;
+}
\ No newline at end of file
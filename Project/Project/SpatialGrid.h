@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Entity.h"
+#include <SFML/Graphics/Rect.hpp>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid of entity bounds over an unbounded plane, only occupied cells
+// are stored. An entity is listed in every cell its bounds touch.
+class SpatialGrid
+{
+public:
+    explicit SpatialGrid(float cellSize = 256.0f) : cellSize(cellSize) {}
+
+    // Inserts or moves an entity, cheap while it stays within the same cells.
+    void update(EntityHandle handle, const sf::FloatRect& bounds);
+    void remove(EntityHandle handle);
+
+    bool contains(EntityHandle handle) const;
+    const sf::FloatRect& getBounds(EntityHandle handle) const { return entries[handle.index].bounds; }
+
+    // Appends every entity whose bounds intersect or touch the area, each once.
+    void query(const sf::FloatRect& area, std::vector<EntityHandle>& result) const;
+
+    std::size_t size() const { return numEntries; }
+    float getCellSize() const { return cellSize; }
+
+    void clear();
+
+private:
+    struct CellRange
+    {
+        int left = 0;
+        int top = 0;
+        int right = -1;
+        int bottom = -1;
+
+        bool operator==(const CellRange& other) const
+        {
+            return left == other.left && top == other.top && right == other.right && bottom == other.bottom;
+        }
+    };
+
+    struct Entry
+    {
+        EntityHandle handle;
+        sf::FloatRect bounds;
+        CellRange cells;
+        bool isActive = false;
+    };
+
+    CellRange getCellRange(const sf::FloatRect& bounds) const;
+    static sf::Uint64 getCellKey(int x, int y);
+
+    void link(std::uint32_t entryIdx, const CellRange& range);
+    void unlink(std::uint32_t entryIdx, const CellRange& range);
+
+    float cellSize;
+
+    // Indexed by EntityHandle::index.
+    std::vector<Entry> entries;
+    std::size_t numEntries = 0;
+
+    std::unordered_map<sf::Uint64, std::vector<std::uint32_t>> cells;
+
+    // Marks entries already reported by the running query.
+    mutable std::vector<sf::Uint32> queryStamps;
+    mutable sf::Uint32 queryStamp = 0;
+};
\ No newline at end of file
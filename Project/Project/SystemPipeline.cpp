@@ -0,0 +1,144 @@
+#include "SystemPipeline.h"
+#include "CommonDefinitions.h"
+#include <algorithm>
+
+static thread_local SystemPipeline::Recording currentRecording;
+
+SystemPipeline::Recording& SystemPipeline::getRecording()
+{
+    return currentRecording;
+}
+
+void SystemPipeline::add(std::string name, QueryId query, Signature reads, Signature writes, System::Update update)
+{
+    System system;
+    system.name = std::move(name);
+    system.query = query;
+    system.reads = reads;
+    system.writes = writes;
+    system.update = std::move(update);
+    systems.push_back(std::move(system));
+    isBuilt = false;
+}
+
+void SystemPipeline::build()
+{
+    graph.clear();
+    predecessors.assign(systems.size(), {});
+
+    for (std::size_t idx = 0; idx < systems.size(); ++idx)
+    {
+        graph.addTask([this, idx]() { runSystem(idx); });
+    }
+
+    // Conflicting systems keep the order they were added in.
+    for (std::size_t after = 0; after < systems.size(); ++after)
+    {
+        const System& laterSystem = systems[after];
+        for (std::size_t before = 0; before < after; ++before)
+        {
+            const System& earlierSystem = systems[before];
+            const bool conflicts = (earlierSystem.writes & (laterSystem.reads | laterSystem.writes)) != 0
+                                || (laterSystem.writes & earlierSystem.reads) != 0;
+            if (conflicts)
+            {
+                graph.addDependency(before, after);
+                predecessors[after].push_back(before);
+            }
+        }
+    }
+    isBuilt = true;
+}
+
+void SystemPipeline::run(const EntityStorage& entities, const sf::Time& elapsedTime)
+{
+    if (!isBuilt) build();
+
+    pEntities = &entities;
+    this->elapsedTime = elapsedTime;
+    graph.run(JOBS);
+
+    findCriticalPath();
+}
+
+void SystemPipeline::runSystem(std::size_t systemIdx)
+{
+    System& system = systems[systemIdx];
+    System::Stats& stats = system.stats;
+    stats.numEntities = (system.query != NO_QUERY) ? pEntities->count(system.query) : 0;
+    if (system.query != NO_QUERY && stats.numEntities == 0)
+    {
+        stats.last = sf::Time::Zero;
+        ++stats.numSkipped;
+        return;
+    }
+
+    // A worker waiting inside parallelFor may run another system in between.
+    const Recording outerRecording = currentRecording;
+    currentRecording = Recording{ static_cast<std::uint32_t>(systemIdx), 0 };
+
+    sf::Clock clock;
+    system.update(elapsedTime);
+    stats.last = clock.getElapsedTime();
+    currentRecording = outerRecording;
+    stats.max = std::max(stats.max, stats.last);
+    stats.total += stats.last;
+    ++stats.numRuns;
+}
+
+void SystemPipeline::findCriticalPath()
+{
+    // Systems were added in dependency order, so one forward pass is enough.
+    std::vector<sf::Time> finish(systems.size());
+    std::vector<std::size_t> previous(systems.size(), systems.size());
+    std::size_t last = systems.size();
+
+    serialTime = sf::Time::Zero;
+    criticalPath = sf::Time::Zero;
+    for (std::size_t idx = 0; idx < systems.size(); ++idx)
+    {
+        sf::Time start;
+        for (std::size_t before : predecessors[idx])
+        {
+            if (finish[before] > start || previous[idx] == systems.size())
+            {
+                start = std::max(start, finish[before]);
+                previous[idx] = before;
+            }
+        }
+        finish[idx] = start + systems[idx].stats.last;
+        serialTime += systems[idx].stats.last;
+
+        if (last == systems.size() || finish[idx] > criticalPath)
+        {
+            criticalPath = finish[idx];
+            last = idx;
+        }
+    }
+
+    criticalSystems.clear();
+    for (std::size_t idx = last; idx < systems.size(); idx = previous[idx])
+    {
+        criticalSystems.push_back(idx);
+    }
+    std::reverse(criticalSystems.begin(), criticalSystems.end());
+}
+
+std::string SystemPipeline::describeCriticalPath() const
+{
+    std::string description;
+    for (std::size_t idx : criticalSystems)
+    {
+        if (!description.empty()) description += " > ";
+        description += systems[idx].name;
+    }
+    return description;
+}
+
+void SystemPipeline::resetStats()
+{
+    for (System& system : systems)
+    {
+        system.stats = System::Stats();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Entity.h"
+#include "JobSystem.h"
+#include <SFML/System.hpp>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Shared state that is not a component, declared in the same masks.
+static constexpr Signature PHYSICS_WORLD = Signature(1) << 31;
+static constexpr Signature ENTITY_TRANSFORMS = Signature(1) << 30;
+static constexpr Signature SCENE_VIEW = Signature(1) << 29;
+static constexpr Signature AUDIO = Signature(1) << 28;
+static constexpr Signature DRAW_GRID = Signature(1) << 27;
+
+struct System
+{
+    using Update = std::function<void(const sf::Time& elapsedTime)>;
+
+    struct Stats
+    {
+        sf::Uint64 numRuns = 0;
+        sf::Uint64 numSkipped = 0;
+        std::size_t numEntities = 0;
+        sf::Time last;
+        sf::Time max;
+        sf::Time total;
+
+        sf::Time average() const { return (numRuns > 0) ? total / static_cast<sf::Int64>(numRuns) : sf::Time::Zero; }
+    };
+
+    std::string name;
+
+    // Entities the system walks, skipped while none match. NO_QUERY always runs.
+    QueryId query;
+    Update update;
+
+    // Components and shared state the system touches.
+    Signature reads = 0;
+    Signature writes = 0;
+
+    Stats stats;
+};
+
+static constexpr QueryId NO_QUERY = std::numeric_limits<QueryId>::max();
+
+// Pipeline index of no system, for work outside any system.
+static constexpr std::uint32_t NO_SYSTEM = std::numeric_limits<std::uint32_t>::max();
+
+// Runs systems on the job system. A system waits for every earlier system it
+// conflicts with (one writes what the other reads or writes), others overlap.
+class SystemPipeline
+{
+public:
+    SystemPipeline() = default;
+    SystemPipeline(const SystemPipeline&) = delete;
+    SystemPipeline& operator=(const SystemPipeline&) = delete;
+
+    void add(std::string name, QueryId query, Signature reads, Signature writes, System::Update update);
+
+    // Rebuilds the dependency graph, run() also does it after add().
+    void build();
+
+    void run(const EntityStorage& entities, const sf::Time& elapsedTime);
+
+    const std::vector<System>& getSystems() const { return systems; }
+
+    // Longest chain of dependent systems in the last run, the floor for its duration.
+    sf::Time getCriticalPath() const { return criticalPath; }
+    sf::Time getSerialTime() const { return serialTime; }
+    std::string describeCriticalPath() const;
+
+    void resetStats();
+
+    // The system running on the calling thread and how many commands it has
+    // recorded in this run. Jobs a system hands to parallelFor run as NO_SYSTEM.
+    struct Recording
+    {
+        std::uint32_t system = NO_SYSTEM;
+        std::uint32_t sequence = 0;
+    };
+    static Recording& getRecording();
+
+private:
+    void runSystem(std::size_t systemIdx);
+    void findCriticalPath();
+
+    std::vector<System> systems;
+    std::vector<std::vector<std::size_t>> predecessors;
+
+    TaskGraph graph;
+    bool isBuilt = false;
+
+    const EntityStorage* pEntities = nullptr;
+    sf::Time elapsedTime;
+
+    sf::Time criticalPath;
+    sf::Time serialTime;
+    std::vector<std::size_t> criticalSystems;
+};
\ No newline at end of file
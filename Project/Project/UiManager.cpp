@@ -1,5 +1,6 @@
 #include "UiManager.h"
 #include "CommonDefinitions.h"
+#include <algorithm>
 
 void Menu::handleEvent(const sf::Event& event)
 {
@@ -25,7 +26,7 @@ void Menu::handleEvent(const sf::Event& event)
         {
             LOG_INFO(options[selected].action);
             PLAY_SOUND("activate");
-            GAME_INSTANCE.exec(options[selected].action, options[selected].args);
+            GAME_INSTANCE.post(options[selected].command, options[selected].args);
         }
         break;
 
@@ -57,7 +58,7 @@ void Menu::handleEvent(const sf::Event& event)
                 {
                     LOG_INFO(options[selected].action);
                     PLAY_SOUND("activate");
-                    GAME_INSTANCE.exec(options[selected].action, options[selected].args);
+                    GAME_INSTANCE.post(options[selected].command, options[selected].args);
                 }
             }
         }
@@ -104,6 +105,15 @@ void Menu::draw(sf::RenderTarget& target, sf::RenderStates states) const
     }
 }
 
+void Menu::capture(UiSnapshot& snapshot) const
+{
+    snapshot.nextText() = text;
+    for (auto& option : options)
+    {
+        snapshot.nextText() = option.text;
+    }
+}
+
 UiManager& UiManager::getInstance()
 {
     const auto& windowConfig = WINDOW_CONFIG;
@@ -133,6 +143,27 @@ void UiManager::draw(sf::RenderTarget& target, sf::RenderStates states) const
     }
 }
 
+void UiManager::capture(UiSnapshot& snapshot) const
+{
+    snapshot.clear();
+    for (const auto& text : uiStaticText)
+    {
+        snapshot.nextText() = text;
+    }
+
+    snapshot.nextText() = fpsText;
+
+    for (const auto& logText : logQueueText)
+    {
+        snapshot.nextText() = logText;
+    }
+
+    if (!GAME_INSTANCE.scene.menuStack.empty())
+    {
+        GAME_INSTANCE.scene.menuStack.top().capture(snapshot);
+    }
+}
+
 void UiManager::AddStaticText(const std::wstring& textString)
 {
     const sf::Font& font = FONT(fontName);
@@ -146,7 +177,7 @@ void UiManager::clearStaticText()
     uiStaticText.clear();
 }
 
-void UiManager::calculateFps(const sf::Time& elapsedTime)
+void UiManager::calculateFps(const sf::Time& elapsedTime, const sf::Time& jitter)
 {
     if (fpsText.getFont() == nullptr)
     {
@@ -161,7 +192,8 @@ void UiManager::calculateFps(const sf::Time& elapsedTime)
     {
         const int fpsNum = sf::seconds(1.0f) / elapsedTime;
         fpsText.setString(std::wstring(L"FPS: ") + std::to_wstring(fpsNum)
-            + L" Frame time: " + std::to_wstring(elapsedTime.asMicroseconds()));
+            + L" Frame time: " + std::to_wstring(elapsedTime.asMicroseconds())
+            + L" Jitter: " + std::to_wstring(jitter.asMicroseconds()));
         lastUpdate = updateClock.getElapsedTime();
     }
 }
@@ -169,13 +201,16 @@ void UiManager::calculateFps(const sf::Time& elapsedTime)
 void UiManager::update(const sf::Time& elapsedTime)
 {
     static sf::Time lastUpdate;
-    if (lastUpdate + sf::seconds(0.1f) <= updateClock.getElapsedTime())
+    if (lastUpdate + refreshInterval <= updateClock.getElapsedTime())
     {
+        // Fade at the same speed however rarely we refresh.
+        const int fadeStep = std::max(1, static_cast<int>(refreshInterval / sf::milliseconds(100)));
+
         int numExpired = 0;
         for (sf::Text& logText : logQueueText)
         {
             sf::Color color = logText.getFillColor();
-            color.a--;
+            color.a = static_cast<sf::Uint8>(std::max(0, color.a - fadeStep));
             if (color.a > 0)
             {
                 logText.setFillColor(color);
@@ -215,7 +250,7 @@ void UiManager::log(const std::wstring logString, LogType type)
     const sf::Font& font = FONT(fontName);
     sf::Text textToDraw(logString, font, charSize);
     textToDraw.setPosition(logTextPosition.x, logTextPosition.y + (charSize * logQueueText.size()));
-    textToDraw.setFillColor((type == LogType::ERROR) ? sf::Color::Red : sf::Color::Green);
+    textToDraw.setFillColor((type == LogType::ERROR) ? sf::Color::Red : (type == LogType::WARNING) ? sf::Color::Yellow : sf::Color::Green);
     logQueueText.push_front(textToDraw);
 
     if (logQueueText.size() > numLogLines)
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "RenderSnapshot.h"
+#include "CommandQueue.h"
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
 #include <string>
@@ -22,6 +24,7 @@ struct Menu : public sf::Drawable, public sf::Transformable
         Type type;
         std::string name;
         std::string action;
+        Command::Type command = Command::Type::NONE;
         std::vector<std::string>args;
         sf::Text text;
     };
@@ -29,6 +32,7 @@ struct Menu : public sf::Drawable, public sf::Transformable
     void handleEvent(const sf::Event& event);
     void update(const sf::Time& elapsedTime);
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+    void capture(UiSnapshot& snapshot) const;
 
     std::string fontName = "pixel_font";
     int charSize = 30;
@@ -45,6 +49,7 @@ public:
     enum class LogType
     {
         INFO,
+        WARNING,
         ERROR
     };
 
@@ -59,10 +64,12 @@ public:
     static UiManager& getInstance();
 
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+    void capture(UiSnapshot& snapshot) const;
     void AddStaticText(const std::wstring& textString);
     void clearStaticText();
-    void calculateFps(const sf::Time& elapsedTime);
+    void calculateFps(const sf::Time& elapsedTime, const sf::Time& jitter);
     void update(const sf::Time& elapsedTime);
+    void setRefreshInterval(const sf::Time& interval) { refreshInterval = interval; }
 
     void log(const std::string logString, LogType type = LogType::INFO);
     void log(const std::wstring logString, LogType type = LogType::INFO);
@@ -71,6 +78,7 @@ private:
     UiManager(float width, float height);
 
     sf::Clock updateClock;
+    sf::Time refreshInterval = sf::milliseconds(100);
 
     float win_width;
     float win_height;
@@ -1,14 +1,27 @@
 #include "CommonDefinitions.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+    CONFIG.setCommandLine(argc, argv);
+
     GAME_INIT();
 
-    const std::string& levelName = CONFIG.getStartLevelName();
+    if (CONFIG.getBenchmarkSettings().enabled)
+    {
+        GAME_START_BENCHMARK();
+    }
+    else if (CONFIG.isHeadless())
+    {
+        GAME_START_HEADLESS();
+    }
+    else
+    {
+        const std::string& levelName = CONFIG.getStartLevelName();
 
-    CONFIG.loadLevel(levelName, GAME_INSTANCE.scene);
+        GAME_INSTANCE.loadLevel(levelName);
 
-    GAME_START();
+        GAME_START();
+    }
 
     g_resources.clear();
 